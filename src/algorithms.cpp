@@ -1,16 +1,24 @@
+#include <atomic>
 #include <list>
+#include <queue>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 using namespace std;
+#include <cassert>
 #include <climits>
 #include "algorithms.h"
 #include "graph.h"
 #include "heuristics.h"
 #include "node_heap.h"
+#include "profile.h"
+#include "search.h"
 
 // These algorithms 'close' nodes by flagging them with the id of the
 // current problem being solved.  This saves us unclosing every node
-// after solving each path.
-short problem_id = 1;
+// after solving each path.  Each thread searches its own graph, so the
+// counter (like the static open lists below) is thread-local.
+thread_local short problem_id = 1;
 
 inline void init_new_problem(Graph & graph, Stats & stats) {
   ++ stats.num_problems;
@@ -23,210 +31,642 @@ inline void init_new_problem(Graph & graph, Stats & stats) {
   }
 }
 
-inline void reconstruct_path(Node* start, Node* current,
-                             unsigned int (*cost)(Node*, Node*),
+/// Search state kept in the Nodes themselves (see search.h).
+struct NodeState {
+  inline void begin(Graph & graph, Stats & stats) { init_new_problem(graph, stats); }
+  inline bool closed(Node* node) { return node->closed(problem_id); }
+  inline void close(Node* node) { node->expand(problem_id); }
+  inline bool is_open(Node* node) { return node->open; }
+  inline void set_open(Node* node, bool open) { node->open = open; }
+  inline int g(Node* node) { return node->g; }
+  inline int f(Node* node) { return node->f; }
+  inline Node* whence(Node* node) { return node->whence; }
+  inline void set_whence(Node* node, Node* whence) { node->whence = whence; }
+  inline void relax(Node* node, int g, int h, Node* whence) { node->relax(g, h, whence); }
+  inline int & heap_index(Node* node) { return node->heap_index; }
+  inline list<Node*>::iterator & fringe_index(Node* node) { return node->fringe_index; }
+};
+
+inline void reconstruct_path(Graph & graph, Node* start, Node* current,
                              Stats & stats) {
-  while (current != start) {
-    stats.path_cost += cost(current->whence, current);
-    ++ stats.path_length;
-    current = current->whence;
+  NodeState state;
+  search::reconstruct_path(graph, start, current, stats, state);
+}
+
+/// Link up the straight line from start to goal when it's the cheapest path.
+// On a grid of uniform weight where a diagonal move costs no less than a
+// cardinal move and no more than two, that line is as cheap as any path, so
+// there's nothing to search for.
+bool direct_line(Graph & graph, Node* start, Node* goal, vector<pair<int, int> > & cells) {
+  if (graph.min_weight != graph.max_weight || graph.diagonal_cost < graph.cardinal_cost ||
+      graph.diagonal_cost > 2 * graph.cardinal_cost)
+    return false;
+  if (graph.edge_type == EDGES_QUARTILE && start->grid_x != goal->grid_x &&
+      start->grid_y != goal->grid_y)
+    return false;
+  if (!graph.line_of_sight(start, goal))
+    return false;
+  cells.clear();
+  graph.passable.octile_line(start->grid_x, start->grid_y, goal->grid_x, goal->grid_y, cells);
+  return true;
+}
+
+bool direct_path(Graph & graph, Node* start, Node* goal) {
+  NodeState state;
+  return search::direct_path(graph, start, goal, state);
+}
+
+/// Drop waypoints from a path (start first), keeping a waypoint only when the
+/// one after it is out of view of the last one kept.  Consecutive waypoints of
+/// the result are joined by walkable octile lines (see Bitboard::octile_line).
+void smooth_path(Graph & graph, vector<Node*> & path) {
+  if (path.size() < 3)
+    return;
+  size_t kept = 0;
+  for (size_t ii = 1; ii < path.size(); ++ ii) {
+    if (ii + 1 < path.size() && graph.line_of_sight(path[kept], path[ii + 1]))
+      continue;
+    path[++ kept] = path[ii];
   }
+  path.resize(kept + 1);
 }
 
 /// A-star with no optimizations, not even sorting the open list.
 /// Additionally contains some validations on the result.
-void astar_basic(Graph & graph, Node* start, Node* goal, Stats & stats,
-                 unsigned int (*h)(Node* n1, Node* n2)) {
-  init_new_problem(graph, stats);
-  static vector<Node*> open_list;
-  start->open = true;
-  start->relax(0, h(start, goal), NULL);
-  open_list.push_back(start);
+bool astar_basic(Graph & graph, Node* start, Node* goal, Stats & stats,
+                 unsigned int (*h)(Graph&, Node*, Node*)) {
+  NodeState state;
+  return search::astar_basic(graph, start, goal, stats, h, state);
+}
 
-  while (!open_list.empty()) {
-    int fmin = INT_MAX;
-    auto best_on_open_list = open_list.begin();
-    // Pop the best node off the open_list via linear scan
-    for (auto node = open_list.begin(); node != open_list.end(); ++ node) {
-      if ((*node)->f < fmin) {
-        fmin = (*node)->f;
-        best_on_open_list = node;
-      }
-    }
-    Node* expand_me = *best_on_open_list;
-    if (expand_me == goal)
-      break;
-    expand_me->expand(problem_id);
-    ++ stats.nodes_expanded;
-    // remove it by overwriting it with the back() node
-    *best_on_open_list = open_list.back();
-    open_list.pop_back();
+/// A* with a binary heap.
+bool astar_heap(Graph & graph, Node* start, Node* goal, Stats & stats,
+                unsigned int (*h)(Graph&, Node*, Node*)) {
+  NodeState state;
+  return search::astar_heap(graph, start, goal, stats, h, state);
+}
 
-    // Add each neighbor
-    for (auto add_me: expand_me->neighbors_out) {
-      if (add_me->closed(problem_id))
-        continue;
-      const int g = expand_me->g + graph.cost(expand_me, add_me);
-      if (!add_me->open) {       // If it's not open, open it
-        add_me->open = true;
-        add_me->relax(g, h(add_me, goal), expand_me);
-        open_list.push_back(add_me);
+/// Fringe search (Bjornsson, Enzenberger, Holte, and Schaeffer '05).
+// Like other algorithms in the A* family, fringe search expands nodes one ply
+// of f values at a time.  Fringe search does this in a depth-first fashion,
+// favoring the expansion of recently touched nodes, which can be accommodated
+// by inserting entries into a linked list.
+//
+// Without aggressive compiler optimizations, Fringe Search beats A* handily.
+bool fringe_search(Graph & graph, Node* start, Node* goal, Stats & stats,
+                   unsigned int (*h)(Graph&, Node*, Node*)) {
+  NodeState state;
+  return search::fringe_search(graph, start, goal, stats, h, state);
+}
+
+/// Basic learning real-time search
+void lrta_basic(Graph & graph, Node* start, Node* goal, Stats & stats,
+                unsigned int (*h)(Graph&, Node*, Node*)) {
+  init_new_problem(graph, stats);
+  while (start != goal) {
+    Node* best_neighbor = 0;
+    unsigned int best_f = INT_MAX, best_cost = 0;
+    stats.nodes_expanded += 1;
+    for (size_t ii = 0; ii < start->neighbors_out.size(); ++ ii) {
+      Node* neighb = start->neighbors_out[ii];
+      // set default heuristic value if it isn't set
+      if (!(neighb->closed(problem_id))) {
+        neighb->expand(problem_id);
+        neighb->f = h(graph, neighb, goal);
       }
-      else if (add_me->g > g) {  // If it is open, relax it
-        add_me->relax(g, h(add_me, goal), expand_me);
+      unsigned int f = start->costs_out[ii] + neighb->f;
+      if (!best_neighbor || f < best_f) {
+        best_neighbor = neighb;
+        best_f = f;
+        best_cost = start->costs_out[ii];
+      }
+      else if (f == best_f && stats.nodes_expanded % 2) {
+        best_neighbor = neighb;
+        best_cost = start->costs_out[ii];
       }
     }
+    start->f = best_f; // learning update
+    stats.path_cost += best_cost;
+    start = best_neighbor;
   }
+  stats.path_length = stats.nodes_expanded;
+}
 
-  // Stats collection & cleanup
-  stats.open_list_size += open_list.size();
-  reconstruct_path(start, goal, graph.cost, stats);
-  for (auto node: open_list)
-    node->open = false;
-  open_list.clear();
+/// Block A* (Yap, Burch, Holte, and Schaeffer '11).
+// Instead of one cell at a time, Block A* expands a whole block of cells: the
+// g values of the block's newly improved ("dirty") cells are carried across the
+// block in one step by looking up the local distance database, and then out
+// through the block's edges into the neighboring blocks.  The open list holds
+// blocks, keyed by the smallest f among their dirty cells, and the search ends
+// once no block's key is below the best g found for the goal.  Cells remember
+// where their g came from, which is either a cell in another block (one move
+// away) or a dirty cell in their own block (a local path away).
+//
+// stats.nodes_expanded counts blocks rather than cells.
+namespace block_search {
+  struct Cell {
+    int g;
+    int parent;                       // grid index
+    unsigned int search_id;
+  };
+
+  struct Block {
+    int key;
+    uint32_t dirty;                   // bit i is set when cell i is dirty
+    unsigned int search_id;
+  };
+
+  thread_local vector<Cell> cells;    // in grid order
+  thread_local vector<Block> blocks;
+  thread_local unsigned int search_id = 0;
+
+  inline Cell & cell(int index) {
+    Cell & here = cells[index];
+    if (here.search_id != search_id) {
+      here.g = INT_MAX;
+      here.parent = -1;
+      here.search_id = search_id;
+    }
+    return here;
+  }
+
+  inline Block & block(int index) {
+    Block & here = blocks[index];
+    if (here.search_id != search_id) {
+      here.key = INT_MAX;
+      here.dirty = 0;
+      here.search_id = search_id;
+    }
+    return here;
+  }
+
+  /// Count the moves on a cheapest path between two cells of the same block
+  /// by walking backward from `to', always stepping to a cell whose local
+  /// distance from `from' accounts for the rest.
+  size_t local_path_length(LocalDistanceDatabase & lddb, uint32_t pattern,
+                           int from, int to) {
+    const int B = LocalDistanceDatabase::BLOCK_SIZE;
+    size_t length = 0;
+    while (to != from) {
+      const int tx = to % B, ty = to / B;
+      int step = -1;
+      for (int ii = 0; ii < LocalDistanceDatabase::CELLS && step < 0; ++ ii) {
+        const int dx = ii % B - tx, dy = ii / B - ty;
+        if (abs(dx) > 1 || abs(dy) > 1 || (!dx && !dy) || !(pattern & (1 << ii)))
+          continue;
+        if (dx && dy && !lddb.corner_cut &&
+            (!(pattern & (1 << (ty * B + tx + dx))) || !(pattern & (1 << ((ty + dy) * B + tx)))))
+          continue;
+        const int move = dx && dy ? lddb.diagonal_cost : lddb.cardinal_cost;
+        if (lddb.distance(pattern, from, ii) != LocalDistanceDatabase::UNREACHABLE &&
+            lddb.distance(pattern, from, ii) + move == lddb.distance(pattern, from, to))
+          step = ii;
+      }
+      assert(step >= 0);
+      to = step;
+      ++ length;
+    }
+    return length;
+  }
 }
 
-/// A* with a binary heap.
-void astar_heap(Graph & graph, Node* start, Node* goal, Stats & stats,
-                unsigned int (*h)(Node* n1, Node* n2)) {
-  init_new_problem(graph, stats);
-  static vector<Node*> open_list;
-  start->open = true;
-  start->relax(0, h(start, goal), NULL);
-  node_heap::push(open_list, start);
+bool block_astar(Graph & graph, Node* start, Node* goal, Stats & stats,
+                 unsigned int (*h)(Graph&, Node*, Node*), LocalDistanceDatabase & lddb) {
+  using namespace block_search;
+  assert(graph.edge_type == EDGES_OCTILE && graph.max_weight == 1);
+  assert(lddb.cardinal_cost == graph.cardinal_cost && lddb.diagonal_cost == graph.diagonal_cost &&
+         lddb.corner_cut == graph.corner_cut);
+  const int B = LocalDistanceDatabase::BLOCK_SIZE;
+  const int blocks_x = (graph.width + B - 1) / B, blocks_y = (graph.height + B - 1) / B;
+  ++ stats.num_problems;
+  if (cells.size() < (size_t) graph.width * graph.height)
+    cells.resize(graph.width * graph.height);
+  if (blocks.size() < (size_t) blocks_x * blocks_y)
+    blocks.resize(blocks_x * blocks_y);
+  // check integer overflow; search ids are no longer unique, so reset.
+  if (++ search_id == 0) {
+    for (auto& here: cells)
+      here.search_id = 0;
+    for (auto& here: blocks)
+      here.search_id = 0;
+    search_id = 1;
+  }
+  auto block_of = [&](int x, int y) { return (y / B) * blocks_x + x / B; };
+  auto local_of = [&](int x, int y) { return (y % B) * B + x % B; };
+
+  typedef pair<int, int> Entry;       // (key, block)
+  priority_queue<Entry, vector<Entry>, greater<Entry> > open_list;
+  const int start_index = start->grid_y * graph.width + start->grid_x;
+  const int goal_index = goal->grid_y * graph.width + goal->grid_x;
+  cell(start_index).g = 0;
+  Block & first = block(block_of(start->grid_x, start->grid_y));
+  first.dirty = 1 << local_of(start->grid_x, start->grid_y);
+  first.key = h(graph, start, goal);
+  open_list.push(make_pair(first.key, block_of(start->grid_x, start->grid_y)));
 
   while (!open_list.empty()) {
-    // Pop the best node off the open_list (+ goal check)
-    Node* expand_me = open_list.front();
-    if (expand_me == goal)
+    const Entry entry = open_list.top();
+    open_list.pop();
+    Block & expand_me = block(entry.second);
+    if (entry.first != expand_me.key)
+      continue;                       // stale
+    if (entry.first >= cell(goal_index).g)
       break;
-
     ++ stats.nodes_expanded;
-    expand_me->expand(problem_id);
-    node_heap::pop(open_list);
+    const int bx = entry.second % blocks_x, by = entry.second / blocks_x;
+    uint32_t pattern = 0;
+    for (int ii = 0; ii < LocalDistanceDatabase::CELLS; ++ ii) {
+      const int xx = bx * B + ii % B, yy = by * B + ii / B;
+      if (graph.in_bounds(xx, yy) && graph.node_at(xx, yy))
+        pattern |= 1 << ii;
+    }
+    uint32_t changed = expand_me.dirty;
+    const uint32_t dirty = expand_me.dirty;
+    expand_me.dirty = 0;
+    expand_me.key = INT_MAX;
 
-    // Add each neighbor
-    for (auto& add_me: expand_me->neighbors_out) {
-      if (add_me->closed(problem_id))
+    // Carry the dirty cells' g values across the block
+    for (int ii = 0; ii < LocalDistanceDatabase::CELLS; ++ ii) {
+      if (!(dirty & (1 << ii)))
         continue;
-      const int g = expand_me->g + graph.cost(expand_me, add_me);
-      if (!add_me->open) {       // If it's not open, open it
-        add_me->open = true;
-        add_me->relax(g, h(add_me, goal), expand_me);
-        node_heap::push(open_list, add_me);
+      const int source = (by * B + ii / B) * graph.width + bx * B + ii % B;
+      const int g_source = cell(source).g;
+      for (int jj = 0; jj < LocalDistanceDatabase::CELLS; ++ jj) {
+        const uint16_t distance = lddb.distance(pattern, ii, jj);
+        if (jj == ii || distance == LocalDistanceDatabase::UNREACHABLE)
+          continue;
+        Cell & target = cell((by * B + jj / B) * graph.width + bx * B + jj % B);
+        if (g_source + distance < target.g) {
+          target.g = g_source + distance;
+          target.parent = source;
+          changed |= 1 << jj;
+        }
       }
-      else if (g < add_me->g) {  // If it is open, relax it
-        add_me->relax(g, add_me->f - add_me->g, expand_me);
-        node_heap::repair(open_list, add_me->heap_index);
+    }
+
+    // Then out of the block, into its neighbors
+    const int g_goal = cell(goal_index).g;
+    for (int jj = 0; jj < LocalDistanceDatabase::CELLS; ++ jj) {
+      if (!(changed & (1 << jj)))
+        continue;
+      Node* here = graph.node_at(bx * B + jj % B, by * B + jj / B);
+      const int here_index = here->grid_y * graph.width + here->grid_x;
+      const int g_here = cell(here_index).g;
+      for (size_t kk = 0; kk < here->neighbors_out.size(); ++ kk) {
+        Node* add_me = here->neighbors_out[kk];
+        const int add_block = block_of(add_me->grid_x, add_me->grid_y);
+        if (add_block == entry.second)
+          continue;
+        const int g = g_here + here->costs_out[kk];
+        const int f = g + h(graph, add_me, goal);
+        Cell & target = cell(add_me->grid_y * graph.width + add_me->grid_x);
+        if (g >= target.g || f >= g_goal)
+          continue;
+        target.g = g;
+        target.parent = here_index;
+        Block & neighbor = block(add_block);
+        neighbor.dirty |= 1 << local_of(add_me->grid_x, add_me->grid_y);
+        if (f < neighbor.key) {
+          neighbor.key = f;
+          open_list.push(make_pair(f, add_block));
+        }
       }
     }
   }
 
-  // Stats collection & cleanup
+  // Stats collection
+  const bool found = cell(goal_index).g != INT_MAX;
   stats.open_list_size += open_list.size();
-  reconstruct_path(start, goal, graph.cost, stats);
-  for (auto& node: open_list)
-    node->open = false;
-  open_list.clear();
+  if (found) {
+    stats.path_cost += cell(goal_index).g;
+    for (int here = goal_index; here != start_index;) {
+      const int parent = cell(here).parent;
+      const int hx = here % graph.width, hy = here / graph.width;
+      const int px = parent % graph.width, py = parent / graph.width;
+      if (block_of(hx, hy) != block_of(px, py))
+        ++ stats.path_length;
+      else {
+        uint32_t pattern = 0;
+        const int bx = hx / B, by = hy / B;
+        for (int ii = 0; ii < LocalDistanceDatabase::CELLS; ++ ii) {
+          const int xx = bx * B + ii % B, yy = by * B + ii / B;
+          if (graph.in_bounds(xx, yy) && graph.node_at(xx, yy))
+            pattern |= 1 << ii;
+        }
+        stats.path_length += local_path_length(lddb, pattern, local_of(px, py), local_of(hx, hy));
+      }
+      here = parent;
+    }
+  }
+  return found;
 }
 
-/// Fringe search (Bjornsson, Enzenberger, Holte, and Schaeffer '05).
-// Like other algorithms in the A* family, fringe search expands nodes one ply
-// of f values at a time.  Fringe search does this in a depth-first fashion,
-// favoring the expansion of recently touched nodes, which can be accommodated
-// by inserting entries into a linked list.
+/// Hash-distributed A* (Kishimoto, Fukunaga, and Botea '09).
+// Every node is owned by one thread, chosen by hashing the 4x4 block of cells
+// it's in (hashing blocks rather than cells keeps most neighbors local).  Each
+// thread runs A* on its own open list, but only over the nodes it owns: when it
+// generates a node owned by another thread, it sends (node, g, parent) to that
+// thread's inbox instead.  Since only the owner ever touches a node's g and
+// whence, the search needs no locks.
 //
-// Without aggressive compiler optimizations, Fringe Search beats A* handily.
-void fringe_search(Graph & graph, Node* start, Node* goal, Stats & stats,
-                   unsigned int (*h)(Node* n1, Node* n2)) {
-  init_new_problem(graph, stats);
-  static list<Node*> Fringe;
-  Fringe.push_back(start);
-  start->open = true;
-  start->relax(0, h(start, goal), NULL);
-  start->fringe_index = Fringe.begin();
-  bool found = false;
-  int f_limit = start->f;
-
-  while (!found && !Fringe.empty()) {
-    int next_f_limit = INT_MAX;
-    for (auto ff = Fringe.begin(); ff != Fringe.end();) {
-      Node* expand_me = *ff;
-      // is this node outside the current depth?
-      if (expand_me->f > f_limit) {
-        if (expand_me->f < next_f_limit)
-          next_f_limit = expand_me->f; // track smallest next depth
-        ++ ff;
-        continue; // skip this one (for now)
-      }
-      if (expand_me == goal) {
-        found = true;
-        break;
-      }
+// The search ends when no thread has an open node that could beat the
+// incumbent path, and no messages are in flight.  Both are tracked by a single
+// counter, `work': the number of busy threads plus the number of messages sent
+// but not yet received.  Only busy threads send, so once `work' reaches zero it
+// stays there, and every thread can see that it's time to stop.
+namespace hda {
+  struct Message {
+    Node* node;
+    Node* parent;
+    int g, f;
+  };
 
-      ++ stats.nodes_expanded;
-      expand_me->expand(problem_id);
+  struct Batch {
+    Batch* next;
+    vector<Message> messages;
+  };
 
-      // Relax the neighbors and put them on the fringe AFTER `expand_me'
-      for (auto& add_me: expand_me->neighbors_out) {
-        if (add_me->closed(problem_id))
-          continue;
-        const int g = expand_me->g + graph.cost(expand_me, add_me);
+  /// A lock-free multi-producer, single-consumer queue of message batches.
+  // Producers push onto a Treiber stack; the consumer takes the whole stack at
+  // once.  Order doesn't matter since the receiver sorts by f anyway.
+  class Inbox {
+   public:
+    Inbox() : head(0) {}
+    void push(Batch* batch) {
+      batch->next = head.load(memory_order_relaxed);
+      while (!head.compare_exchange_weak(batch->next, batch, memory_order_release,
+                                         memory_order_relaxed));
+    }
+    Batch* take_all() { return head.exchange(0, memory_order_acquire); }
+   private:
+    atomic<Batch*> head;
+  };
+
+  typedef node_heap::Entry<Node*> Entry;
+
+  const size_t FLUSH_SIZE = 64;       // messages per outgoing batch
+  const int FLUSH_EVERY = 16;         // expansions between flushes
+
+  struct Search {
+    Graph * graph;
+    Node * goal;
+    unsigned int (*h)(Graph&, Node*, Node*);
+    vector<int> best_g;               // by graph_index; written by the owner only
+    vector<Inbox> inboxes;
+    atomic<long> work;                // the search is over when this hits zero
+    atomic<size_t> nodes_expanded, open_list_size;
+    atomic<int> incumbent;            // cost of the best path to the goal so far
+    unsigned int num_threads;
 
-        if (!add_me->open) {
-          add_me->open = true;
-          add_me->relax(g, h(add_me, goal), expand_me);
-          auto insertion_point = next(ff);
-          add_me->fringe_index = Fringe.insert(insertion_point, add_me);
+    inline size_t owner(Node* node) {
+      const uint32_t block = ((uint32_t) (node->grid_x >> 2) * 0x9E3779B1u) ^
+        ((uint32_t) (node->grid_y >> 2) * 0x85EBCA77u);
+      return (block ^ (block >> 16)) % num_threads;
+    }
+  };
+
+  /// Accept a path to a node we own, if it's better than what we have.
+  inline void receive(Search & search, priority_queue<Entry> & open_list,
+                      const Message & message) {
+    Node* node = message.node;
+    if (message.g >= search.best_g[node->graph_index])
+      return;
+    search.best_g[node->graph_index] = message.g;
+    node->whence = message.parent;
+    if (node == search.goal)
+      search.incumbent.store(message.g);
+    else if (message.f < search.incumbent.load(memory_order_relaxed)) {
+      Entry entry = {message.f, message.g, node};
+      open_list.push(entry);
+    }
+  }
+
+  void flush(Search & search, vector<Batch*> & outgoing, size_t destination) {
+    Batch* batch = outgoing[destination];
+    if (batch->messages.empty())
+      return;
+    search.work += batch->messages.size();
+    search.inboxes[destination].push(batch);
+    outgoing[destination] = new Batch();
+  }
+
+  void worker(Search & search, size_t me) {
+    priority_queue<Entry> open_list;
+    vector<Batch*> outgoing(search.num_threads);
+    for (auto& batch: outgoing)
+      batch = new Batch();
+    bool busy = false;
+    size_t nodes_expanded = 0;
+    int since_flush = 0;
+
+    while (search.work.load() != 0) {
+      // Receive; the first message to an idle thread pays for making it busy
+      for (Batch* batch = search.inboxes[me].take_all(); batch;) {
+        long received = batch->messages.size();
+        if (!busy) {
+          busy = true;
+          -- received;
         }
-        else if (g < add_me->g) {
-          add_me->relax(g, add_me->f - add_me->g, expand_me);
-          auto insertion_point = next(ff);
-          if (*insertion_point != add_me) {
-            Fringe.erase(add_me->fringe_index);
-            add_me->fringe_index = Fringe.insert(insertion_point, add_me);
+        search.work -= received;
+        for (auto& message: batch->messages)
+          receive(search, open_list, message);
+        Batch* next = batch->next;
+        delete batch;
+        batch = next;
+      }
+
+      // Expand
+      if (!open_list.empty() &&
+          open_list.top().f >= search.incumbent.load(memory_order_relaxed))
+        open_list = priority_queue<Entry>(); // nothing left can beat the incumbent
+      if (!open_list.empty()) {
+        const Entry entry = open_list.top();
+        open_list.pop();
+        Node* expand_me = entry.payload;
+        if (entry.g != search.best_g[expand_me->graph_index])
+          continue;                   // stale
+        ++ nodes_expanded;
+        for (size_t ii = 0; ii < expand_me->neighbors_out.size(); ++ ii) {
+          Node* add_me = expand_me->neighbors_out[ii];
+          const int g = entry.g + expand_me->costs_out[ii];
+          const int f = g + search.h(*search.graph, add_me, search.goal);
+          if (f >= search.incumbent.load(memory_order_relaxed))
+            continue;
+          Message message = {add_me, expand_me, g, f};
+          const size_t destination = search.owner(add_me);
+          if (destination == me)
+            receive(search, open_list, message);
+          else {
+            outgoing[destination]->messages.push_back(message);
+            if (outgoing[destination]->messages.size() >= FLUSH_SIZE)
+              flush(search, outgoing, destination);
           }
         }
+        if (++ since_flush >= FLUSH_EVERY) {
+          for (size_t tt = 0; tt < search.num_threads; ++ tt)
+            flush(search, outgoing, tt);
+          since_flush = 0;
+        }
+        continue;
       }
-      ff = Fringe.erase(ff);
+
+      // Out of work: send what's buffered, then go idle
+      if (busy) {
+        for (size_t tt = 0; tt < search.num_threads; ++ tt)
+          flush(search, outgoing, tt);
+        busy = false;
+        -- search.work;
+      }
+      else
+        this_thread::yield();
     }
-    // Increase the depth and scan the fringe again
-    f_limit = next_f_limit;
+
+    for (auto& batch: outgoing)
+      delete batch;
+    search.nodes_expanded += nodes_expanded;
+    search.open_list_size += open_list.size();
   }
+}
+
+bool hda_star(Graph & graph, Node* start, Node* goal, Stats & stats,
+              unsigned int (*h)(Graph&, Node*, Node*), size_t num_threads) {
+  assert(num_threads > 0);
+  ++ stats.num_problems;
+  hda::Search search;
+  search.graph = &graph;
+  search.goal = goal;
+  search.h = h;
+  search.num_threads = num_threads;
+  search.best_g.assign(graph.size(), INT_MAX);
+  search.inboxes = vector<hda::Inbox>(num_threads);
+  search.incumbent = INT_MAX;
+  search.nodes_expanded = 0;
+  search.open_list_size = 0;
+
+  // Seed the start node's owner; the message in flight counts as work
+  hda::Batch* seed = new hda::Batch();
+  hda::Message message = {start, NULL, 0, (int) h(graph, start, goal)};
+  seed->messages.push_back(message);
+  search.work = 1;
+  search.inboxes[search.owner(start)].push(seed);
+
+  vector<thread> threads;
+  for (size_t ii = 1; ii < num_threads; ++ ii)
+    threads.push_back(thread(hda::worker, ref(search), ii));
+  hda::worker(search, 0);
+  for (auto& th: threads)
+    th.join();
 
   // Stats collection & cleanup
-  stats.open_list_size += Fringe.size();
-  reconstruct_path(start, goal, graph.cost, stats);
-  for (auto& node: Fringe)
-    node->open = false;
-  Fringe.clear();
+  const bool found = search.incumbent.load() != INT_MAX;
+  stats.nodes_expanded += search.nodes_expanded;
+  stats.open_list_size += search.open_list_size;
+  if (found)
+    reconstruct_path(graph, start, goal, stats);
+  for (size_t ii = 0; ii < num_threads; ++ ii) {
+    for (hda::Batch* batch = search.inboxes[ii].take_all(); batch;) {
+      hda::Batch* next = batch->next;
+      delete batch;
+      batch = next;
+    }
+  }
+  return found;
 }
 
-/// Basic learning real-time search
-void lrta_basic(Graph & graph, Node* start, Node* goal, Stats & stats,
-                unsigned int (*h)(Node* n1, Node* n2)) {
-  init_new_problem(graph, stats);
-  while (start != goal) {
-    Node* best_neighbor = 0;
-    unsigned int best_f = INT_MAX;
-    stats.nodes_expanded += 1;
-    for (auto& neighb: start->neighbors_out) {
-      // set default heuristic value if it isn't set
-      if (!(neighb->closed(problem_id))) {
-        neighb->expand(problem_id);
-        neighb->f = h(neighb, goal);
+/// A* with a binary heap over a TiledGrid.
+// There are no Nodes to hold the search state, so it lives in a table that's
+// indexed by cell, and only covers the cells this search has generated.  The
+// heap is lazy: instead of repairing an entry whose g improved, we push a new
+// one and skip the stale one when it surfaces.  With a consistent heuristic a
+// cell is never improved after it's expanded, so no closed flag is needed.
+struct TiledState {
+  uint32_t x, y;
+  uint32_t parent;                    // index into the state table
+  int g;
+};
+
+typedef node_heap::Entry<uint32_t> TiledEntry; // payload is the index in `states'
+
+inline unsigned int tiled_heuristic(TiledGrid & grid, uint32_t x, uint32_t y,
+                                    uint32_t goal_x, uint32_t goal_y) {
+  const unsigned int dx = x > goal_x ? x - goal_x : goal_x - x;
+  const unsigned int dy = y > goal_y ? y - goal_y : goal_y - y;
+  const int diagonal_minus_cardinal = grid.diagonal_cost - grid.cardinal_cost;
+  if (dx > dy)
+    return grid.min_weight * (grid.cardinal_cost * dx + diagonal_minus_cardinal * dy);
+  return grid.min_weight * (grid.cardinal_cost * dy + diagonal_minus_cardinal * dx);
+}
+
+bool astar_tiled(TiledGrid & grid, uint32_t start_x, uint32_t start_y,
+                 uint32_t goal_x, uint32_t goal_y, Stats & stats) {
+  static const int dirs[8][2] = {{0, -1}, {-1, 0}, {1, 0}, {0, 1},
+                                 {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+  ++ stats.num_problems;
+  const size_t faults_before = grid.faults;
+  if (!grid.weight(start_x, start_y) || !grid.weight(goal_x, goal_y))
+    return false;
+  static thread_local vector<TiledState> states;
+  static thread_local unordered_map<uint64_t, uint32_t> index;
+  priority_queue<TiledEntry> open_list;
+  TiledState start = {start_x, start_y, UINT32_MAX, 0};
+  states.push_back(start);
+  index[(uint64_t) start_y * grid.width + start_x] = 0;
+  TiledEntry first = {(int) tiled_heuristic(grid, start_x, start_y, goal_x, goal_y), 0, 0};
+  open_list.push(first);
+
+  bool found = false;
+  uint32_t goal_state = 0;
+  while (!open_list.empty()) {
+    const TiledEntry entry = open_list.top();
+    open_list.pop();
+    const TiledState here = states[entry.payload];
+    if (entry.g != here.g)
+      continue;                       // stale
+    if (here.x == goal_x && here.y == goal_y) {
+      found = true;
+      goal_state = entry.payload;
+      break;
+    }
+    ++ stats.nodes_expanded;
+    const unsigned int here_weight = grid.weight(here.x, here.y);
+
+    // Add each neighbor (diagonals can't cut corners)
+    for (int ii = 0; ii < 8; ++ ii) {
+      const uint32_t xx = here.x + dirs[ii][0], yy = here.y + dirs[ii][1];
+      const unsigned int weight = grid.weight(xx, yy);
+      if (!weight)
+        continue;
+      if (ii >= 4 && (!grid.weight(xx, here.y) || !grid.weight(here.x, yy)))
+        continue;
+      const int move_cost = ii < 4 ? grid.cardinal_cost : grid.diagonal_cost;
+      const int g = here.g + move_cost * (here_weight + weight) / 2;
+      auto inserted = index.insert(make_pair((uint64_t) yy * grid.width + xx,
+                                             (uint32_t) states.size()));
+      if (inserted.second) {
+        TiledState add_me = {xx, yy, entry.payload, g};
+        states.push_back(add_me);
       }
-      unsigned int f = graph.cost(start, neighb) + neighb->f;
-      if (!best_neighbor || f < best_f) {
-        best_neighbor = neighb;
-        best_f = f;
+      else if (g < states[inserted.first->second].g) {
+        states[inserted.first->second].g = g;
+        states[inserted.first->second].parent = entry.payload;
       }
-      else if (f == best_f && stats.nodes_expanded % 2)
-        best_neighbor = neighb;
+      else
+        continue;
+      TiledEntry push_me = {g + (int) tiled_heuristic(grid, xx, yy, goal_x, goal_y),
+                            g, inserted.first->second};
+      open_list.push(push_me);
     }
-    start->f = best_f; // learning update
-    stats.path_cost += graph.cost(start, best_neighbor);
-    start = best_neighbor;
   }
-  stats.path_length = stats.nodes_expanded;
+
+  // Stats collection & cleanup
+  stats.open_list_size += open_list.size();
+  if (found) {
+    stats.path_cost += states[goal_state].g;
+    for (uint32_t ss = goal_state; states[ss].parent != UINT32_MAX; ss = states[ss].parent)
+      ++ stats.path_length;
+  }
+  stats.tiles_faulted += grid.faults - faults_before;
+  states.clear();
+  index.clear();
+  return found;
 }
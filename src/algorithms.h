@@ -2,22 +2,58 @@
 #define ALGORITHMS_H
 #include "stats.h"
 #include "graph.h"
+#include "lddb.h"
+#include "tiled_grid.h"
+
+// The optimal searches return whether a path to the goal exists; when it does,
+// its cost and length are accumulated into `stats'.
 
 /// A-star with no optimizations, not even sorting of the open list.
 /// Additionally contains some validations on the result.
-void astar_basic(Graph & graph, Node* ss, Node* gg, Stats & stats,
-                 unsigned int (*h)(Node* n1, Node* n2));
+bool astar_basic(Graph & graph, Node* ss, Node* gg, Stats & stats,
+                 unsigned int (*h)(Graph&, Node*, Node*));
 
-/// A* with a binary heap.
-void astar_heap(Graph & graph, Node* ss, Node* gg, Stats & stats,
-                unsigned int (*h)(Node* n1, Node* n2));
+/// A* with a binary heap.  When the goal is in plain view of the start (see
+/// direct_path), the straight line is returned without searching.
+bool astar_heap(Graph & graph, Node* ss, Node* gg, Stats & stats,
+                unsigned int (*h)(Graph&, Node*, Node*));
 
 /// Fringe search (Bjornsson, Enzenberger, Holte, and Schaeffer '05).
-void fringe_search(Graph & graph, Node* ss, Node* gg, Stats & stats,
-                   unsigned int (*h)(Node* n1, Node* n2));
+bool fringe_search(Graph & graph, Node* ss, Node* gg, Stats & stats,
+                   unsigned int (*h)(Graph&, Node*, Node*));
+
+/// If the straight octile line from ss to gg is walkable and as cheap as any
+/// path (uniform terrain weights, and diagonal moves cost between one and two
+/// cardinal moves), link it up through each node's `whence' and return true.
+/// Assumes the graph's edges follow its cells, as they do unless edges have
+/// been removed with Graph::remove_edge.
+bool direct_path(Graph & graph, Node* ss, Node* gg);
+
+/// The test behind direct_path: when it passes, `cells' holds the line from ss
+/// to gg, both included.
+bool direct_line(Graph & graph, Node* ss, Node* gg, vector<pair<int, int> > & cells);
+
+/// Shorten a path of adjacent nodes into waypoints joined by lines of sight.
+void smooth_path(Graph & graph, vector<Node*> & path);
 
 /// Basic learning real-time search
 void lrta_basic(Graph & graph, Node* ss, Node* gg, Stats & stats,
-                unsigned int (*h)(Node* n1, Node* n2));
+                unsigned int (*h)(Graph&, Node*, Node*));
+
+/// Block A* (Yap, Burch, Holte, and Schaeffer '11): expands whole blocks of
+/// cells at a time using a local distance database built for the graph's move
+/// costs.  Needs an octile graph without terrain weights.
+bool block_astar(Graph & graph, Node* ss, Node* gg, Stats & stats,
+                 unsigned int (*h)(Graph&, Node*, Node*), LocalDistanceDatabase & lddb);
+
+/// Hash-distributed A* (Kishimoto, Fukunaga, and Botea '09), for speeding up a
+/// single long search with `num_threads' (at least one) threads.
+bool hda_star(Graph & graph, Node* ss, Node* gg, Stats & stats,
+              unsigned int (*h)(Graph&, Node*, Node*), size_t num_threads);
+
+/// A* with a binary heap over a TiledGrid, for maps too large to hold a Node
+/// per cell.  Tiles are paged in as the search reaches them.
+bool astar_tiled(TiledGrid & grid, uint32_t start_x, uint32_t start_y,
+                 uint32_t goal_x, uint32_t goal_y, Stats & stats);
 
 #endif // ALGORITHMS_H
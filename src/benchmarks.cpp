@@ -1,16 +1,80 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <fstream>
+#include <map>
+#include <thread>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
 using namespace std;
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include "benchmarks.h"
 #include "graph.h"
 #include "heuristics.h"
 #include "algorithms.h"
+#include "canonical_dijkstra.h"
+#include "profile.h"
 #include "stats.h"
+#include "workload.h"
 
 const int RANDOM_SEED = 10;
 
+/// A dim x dim map with a quarter of its cells (but neither corner) blocked.
+void load_random_map(Graph & graph, int dim) {
+  graph.load_empty_map(dim, dim, EDGES_OCTILE);
+  Rng rng(RANDOM_SEED);
+  for (int yy = 0; yy < dim; ++ yy)
+    for (int xx = 0; xx < dim; ++ xx)
+      if (rng.below(4) == 0 && xx + yy > 0 && xx + yy < 2 * dim - 2)
+        graph.set_blocked(xx, yy);
+  graph.commit_edits();
+}
+
+/// Counts hardware cache misses in this thread, where the kernel allows it.
+class CacheMissCounter {
+ public:
+  CacheMissCounter() {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  ~CacheMissCounter() {
+    if (fd >= 0)
+      close(fd);
+  }
+  inline bool available() { return fd >= 0; }
+  void start() {
+    if (fd < 0)
+      return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  long long stop() {
+    long long count = -1;
+    if (fd < 0)
+      return count;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+      count = -1;
+    return count;
+  }
+ private:
+  int fd;
+};
+
 /// Test a random set of problems
 void benchmark_all_algorithms(Graph & graph, int num_problems,
-                              unsigned int (*heuristic)(Node*, Node*),
+                              unsigned int (*heuristic)(Graph&, Node*, Node*),
                               bool print_stats) {
   Stats stats_lrta_basic("LRTA* (suboptimal)");
   srand(RANDOM_SEED);
@@ -76,8 +140,420 @@ void benchmark_grid_costs() {
   for (size_t ii = 0; ii < 4; ++ ii) {
     cout << endl << "Diagonal: " << test_costs[ii][0]
          << "/Cardinal: " << test_costs[ii][1] << endl;
-    grid_costs(test_costs[ii][0], test_costs[ii][1]);
+    graph.grid_costs(test_costs[ii][0], test_costs[ii][1]);
     benchmark_all_algorithms(graph, num_problems, &octile_heuristic, true);
   }
 
 }
+
+/// Search an ascii map through a TiledGrid with a given tile budget.
+void benchmark_tiled_grid(string map_filename, uint32_t tile_size, size_t max_resident) {
+  size_t num_problems = 10000;
+
+  Graph graph;
+  graph.load_ascii_map(map_filename, EDGES_OCTILE, false, true);
+  const string tiled_filename = map_filename + ".tiled";
+  TiledGrid::convert_ascii_map(map_filename, tiled_filename, graph.terrain, tile_size);
+  TiledGrid grid;
+  grid.open(tiled_filename, max_resident);
+  cout << endl << "Tiles: " << tile_size << "x" << tile_size << ", "
+       << grid.tiles_x * grid.tiles_y << " on disk, " << max_resident << " resident" << endl;
+
+  Stats stats_astar_tiled("A* on tiles");
+  srand(RANDOM_SEED);
+  for (size_t ii = 0; ii < num_problems; ++ ii) {
+    Node *ss = 0, *gg = 0;
+    while (ss == gg) {
+      ss = graph.random_node();
+      gg = graph.random_node();
+    }
+    astar_tiled(grid, ss->grid_x, ss->grid_y, gg->grid_x, gg->grid_y, stats_astar_tiled);
+  }
+  stats_astar_tiled.print();
+  grid.close();
+  remove(tiled_filename.c_str());
+}
+
+/// Time one corner-to-corner search on a random dim x dim map with HDA*,
+/// doubling the number of threads each time.
+void benchmark_hda_star(int dim, size_t max_threads) {
+  Graph graph;
+  load_random_map(graph, dim);
+  Node *ss = graph.node_at(0, 0), *gg = graph.node_at(dim - 1, dim - 1);
+
+  Stats stats_astar_heap("A* with a heap");
+  auto started = chrono::steady_clock::now();
+  astar_heap(graph, ss, gg, stats_astar_heap, &octile_heuristic);
+  const double baseline = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+  stats_astar_heap.print();
+  cout << " Wall time (sec): " << baseline << endl;
+
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    Stats stats_hda_star("HDA*");
+    started = chrono::steady_clock::now();
+    hda_star(graph, ss, gg, stats_hda_star, &octile_heuristic, threads);
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << "HDA* with " << threads << " thread(s):" << endl;
+    cout << " Nodes expanded: " << stats_hda_star.nodes_expanded << endl;
+    cout << " Path cost: " << stats_hda_star.path_cost
+         << (stats_hda_star.path_cost == stats_astar_heap.path_cost ? " (optimal)" : " (WRONG)") << endl;
+    cout << " Wall time (sec): " << seconds << endl;
+    cout << " Speedup over A*: " << baseline / seconds << endl;
+  }
+}
+
+/// Compare node orders (see Graph::reorder) on the same set of problems.  An
+/// empty map_filename means a random 1024x1024 map.
+void benchmark_node_orders(string map_filename) {
+  const size_t num_problems = map_filename.empty() ? 200 : 10000;
+  // ORDER_NONE leaves each node where it was allocated, as the other
+  // benchmarks do; the rest are packed (see Graph::reorder)
+  const NodeOrder orders[5] = {ORDER_NONE, ORDER_ROW_MAJOR, ORDER_MORTON, ORDER_HILBERT,
+                               ORDER_BLOCKS};
+  const char * order_names[5] = {"allocation", "Row-major", "Morton", "Hilbert", "8x8 blocks"};
+  vector<int> coordinates;
+  for (int order = 0; order < 5; ++ order) {
+    Graph graph;
+    if (map_filename.empty()) {
+      load_random_map(graph, 1024);
+      graph.reorder(orders[order]);
+    }
+    else {
+      graph.load_ascii_map(map_filename, EDGES_OCTILE, false, false, orders[order]);
+    }
+    // Sampled once, from the first graph
+    if (coordinates.empty()) {
+      srand(RANDOM_SEED);
+      for (size_t ii = 0; ii < num_problems; ++ ii) {
+        Node *ss = 0, *gg = 0;
+        while (ss == gg) {
+          ss = graph.random_node();
+          gg = graph.random_node();
+        }
+        int pair[4] = {ss->grid_x, ss->grid_y, gg->grid_x, gg->grid_y};
+        coordinates.insert(coordinates.end(), pair, pair + 4);
+      }
+    }
+
+    Stats stats_astar_heap(string("A* with a heap, ") + order_names[order] + " order");
+    CacheMissCounter cache_misses;
+    auto started = chrono::steady_clock::now();
+    cache_misses.start();
+    for (size_t ii = 0; ii < coordinates.size(); ii += 4)
+      astar_heap(graph, graph.node_at(coordinates[ii], coordinates[ii + 1]),
+                 graph.node_at(coordinates[ii + 2], coordinates[ii + 3]),
+                 stats_astar_heap, &octile_heuristic);
+    const long long misses = cache_misses.stop();
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    stats_astar_heap.print();
+    cout << " Expansions per second: " << stats_astar_heap.nodes_expanded / seconds << endl;
+    if (misses >= 0)
+      cout << " Cache misses per expansion: "
+           << misses / (double) stats_astar_heap.nodes_expanded << endl;
+    else
+      cout << " Cache misses per expansion: unavailable" << endl;
+  }
+}
+
+/// The directory holding a file, for caching things next to it.
+string directory_of(string filename) {
+  const size_t slash = filename.rfind('/');
+  return slash == string::npos ? "." : filename.substr(0, slash);
+}
+
+/// Compare Block A* with A* on the same problems, reporting how long the local
+/// distance database took to get (built, or read from the cache).
+void benchmark_block_astar(string map_filename) {
+  Graph graph;
+  if (map_filename.empty())
+    load_random_map(graph, 1024);
+  else
+    graph.load_ascii_map(map_filename, EDGES_OCTILE);
+  const size_t num_problems = map_filename.empty() ? 200 : 10000;
+  // Keep the database next to the map (a random map's goes with the others)
+  auto started = chrono::steady_clock::now();
+  LocalDistanceDatabase & lddb = LocalDistanceDatabase::cached(
+    graph.cardinal_cost, graph.diagonal_cost, graph.corner_cut,
+    map_filename.empty() ? "../maps" : directory_of(map_filename));
+  cout << "Local distance database " << (lddb.loaded_from_disk ? "loaded" : "built") << " in "
+       << chrono::duration<double>(chrono::steady_clock::now() - started).count()
+       << " sec" << endl;
+
+  srand(RANDOM_SEED);
+  vector<pair<Node*, Node*> > problems;
+  while (problems.size() < num_problems) {
+    Node *ss = graph.random_node(), *gg = graph.random_node();
+    if (ss != gg)
+      problems.push_back(make_pair(ss, gg));
+  }
+  Stats stats_astar_heap("A* with a heap"), stats_block_astar("Block A* (expanding blocks)");
+  started = chrono::steady_clock::now();
+  for (auto& problem: problems)
+    astar_heap(graph, problem.first, problem.second, stats_astar_heap, &octile_heuristic);
+  const double astar_seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+  started = chrono::steady_clock::now();
+  for (auto& problem: problems)
+    block_astar(graph, problem.first, problem.second, stats_block_astar, &octile_heuristic, lddb);
+  const double block_seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+  assert(stats_block_astar.path_cost == stats_astar_heap.path_cost);
+  stats_astar_heap.print();
+  cout << " Search time (sec): " << astar_seconds << endl;
+  stats_block_astar.print();
+  cout << " Search time (sec): " << block_seconds << endl;
+}
+
+/// Line-of-sight checks per second, a word at a time and a cell at a time.
+void benchmark_line_of_sight(string map_filename) {
+  Graph graph;
+  if (map_filename.empty())
+    load_random_map(graph, 1024);
+  else
+    graph.load_ascii_map(map_filename, EDGES_OCTILE);
+  const size_t num_checks = 1000000;
+  srand(RANDOM_SEED);
+  vector<int> coordinates;
+  for (size_t ii = 0; ii < num_checks; ++ ii) {
+    Node *ss = graph.random_node(), *gg = graph.random_node();
+    int pair[4] = {ss->grid_x, ss->grid_y, gg->grid_x, gg->grid_y};
+    coordinates.insert(coordinates.end(), pair, pair + 4);
+  }
+  for (int cellwise = 0; cellwise <= 1; ++ cellwise) {
+    size_t visible = 0;
+    auto started = chrono::steady_clock::now();
+    for (size_t ii = 0; ii < coordinates.size(); ii += 4) {
+      const int * pair = &coordinates[ii];
+      if (cellwise)
+        visible += graph.passable.line_of_sight_cellwise(pair[0], pair[1], pair[2], pair[3],
+                                                         graph.corner_cut);
+      else
+        visible += graph.passable.line_of_sight(pair[0], pair[1], pair[2], pair[3],
+                                                graph.corner_cut);
+    }
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << (cellwise ? "Cell at a time" : "Bitboard") << " line of sight, "
+         << graph.width << "x" << graph.height << ":" << endl;
+    cout << " Checks: " << num_checks << " (" << visible << " visible)" << endl;
+    cout << " Checks per second: " << num_checks / seconds << endl;
+  }
+}
+
+// The maps `make bench' runs on, and how many queries to draw per bucket
+const char * BENCH_MAPS[2] = {"../maps/example.map", "../maps/random-256.map"};
+const unsigned int BENCH_PER_BUCKET[2] = {100, 20};
+const unsigned int BENCH_BUCKETS = 10;
+const int BENCH_RUNS = 3;                 // each query's best time is kept
+const char * BENCH_ALGORITHMS[6] = {"astar_basic", "astar_heap", "fringe_search",
+                                    "block_astar", "hda_star_2", "astar_tiled"};
+
+struct BenchResult {
+  double throughput;                      // queries per second
+  double median_us, p99_us;               // latency
+};
+
+bool run_bench_query(int algorithm, Graph & graph, TiledGrid & tiled,
+                     LocalDistanceDatabase * lddb, Query & query, Stats & stats) {
+  Node * ss = graph.node_at(query.start_x, query.start_y);
+  Node * gg = graph.node_at(query.goal_x, query.goal_y);
+  switch (algorithm) {
+  case 0: return astar_basic(graph, ss, gg, stats, &octile_heuristic);
+  case 1: return astar_heap(graph, ss, gg, stats, &octile_heuristic);
+  case 2: return fringe_search(graph, ss, gg, stats, &octile_heuristic);
+  case 3: return block_astar(graph, ss, gg, stats, &octile_heuristic, *lddb);
+  case 4: return hda_star(graph, ss, gg, stats, &octile_heuristic, 2);
+  default: return astar_tiled(tiled, query.start_x, query.start_y,
+                              query.goal_x, query.goal_y, stats);
+  }
+}
+
+/// Load the workload for a map from beside it, generating (and saving) the
+/// map and the workload if they're missing.
+void load_bench_workload(int index, Workload & workload) {
+  const string map_filename = BENCH_MAPS[index];
+  if (!ifstream(map_filename.c_str()).good())
+    write_random_map(map_filename, 256, RANDOM_SEED);
+  const string workload_filename = map_filename + ".workload";
+  if (workload.load(workload_filename) && workload.map_filename == map_filename)
+    return;
+  Graph graph;
+  graph.load_ascii_map(map_filename, EDGES_OCTILE);
+  workload.generate(graph, map_filename, RANDOM_SEED, BENCH_BUCKETS, BENCH_PER_BUCKET[index]);
+  workload.save(workload_filename);
+  cout << "Generated " << workload_filename << endl;
+}
+
+/// Run every optimal search over the saved workloads, checking each path cost
+/// against the workload's, and compare throughput and latency against the
+/// baseline file.  Returns nonzero if any cost is wrong or any measurement is
+/// worse than the baseline by more than `threshold' (a fraction).  With
+/// `update_baseline', the baseline file is rewritten instead.
+int benchmark_workloads(string baseline_filename, double threshold, bool update_baseline) {
+  map<string, BenchResult> baseline;
+  ifstream baseline_file(baseline_filename.c_str(), ios::in);
+  string map_name, algorithm_name;
+  BenchResult result;
+  while (baseline_file >> map_name >> algorithm_name >> result.throughput
+         >> result.median_us >> result.p99_us)
+    baseline[map_name + " " + algorithm_name] = result;
+  stringstream new_baseline;
+  int failures = 0;
+
+  for (int mm = 0; mm < 2; ++ mm) {
+    Workload workload;
+    load_bench_workload(mm, workload);
+    Graph graph;
+    graph.load_ascii_map(workload.map_filename, EDGES_OCTILE);
+    const string tiled_filename = workload.map_filename + ".tiled";
+    TiledGrid::convert_ascii_map(workload.map_filename, tiled_filename, graph.terrain);
+    TiledGrid tiled;
+    tiled.open(tiled_filename);
+    tiled.grid_costs(graph.cardinal_cost, graph.diagonal_cost);
+    LocalDistanceDatabase * lddb = graph.max_weight == 1 ?
+      &LocalDistanceDatabase::cached(graph.cardinal_cost, graph.diagonal_cost, graph.corner_cut,
+                                     directory_of(workload.map_filename)) : 0;
+    map_name = workload.map_filename.substr(workload.map_filename.rfind('/') + 1);
+    cout << map_name << ": " << workload.queries.size() << " queries in "
+         << workload.num_buckets << " buckets of width " << workload.bucket_width << endl;
+
+    for (int aa = 0; aa < 6; ++ aa) {
+      if (aa == 3 && !lddb)
+        continue;
+      const size_t num_queries = workload.queries.size();
+      vector<double> latencies(num_queries, 1e300);
+      double best_seconds = 1e300;
+      size_t wrong = 0;
+      for (int run = 0; run < BENCH_RUNS; ++ run) {
+        Stats stats;
+        double seconds = 0;
+        for (size_t qq = 0; qq < num_queries; ++ qq) {
+          Query & query = workload.queries[qq];
+          const double cost_before = stats.path_cost;
+          auto started = chrono::steady_clock::now();
+          const bool found = run_bench_query(aa, graph, tiled, lddb, query, stats);
+          const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+          seconds += elapsed;
+          latencies[qq] = min(latencies[qq], elapsed * 1e6);
+          if (!found || stats.path_cost - cost_before != query.cost)
+            ++ wrong;
+        }
+        best_seconds = min(best_seconds, seconds);
+      }
+      sort(latencies.begin(), latencies.end());
+      result.throughput = num_queries / best_seconds;
+      result.median_us = latencies[num_queries / 2];
+      result.p99_us = latencies[num_queries * 99 / 100];
+      algorithm_name = BENCH_ALGORITHMS[aa];
+      new_baseline << map_name << " " << algorithm_name << " " << result.throughput << " "
+                   << result.median_us << " " << result.p99_us << endl;
+      cout << " " << algorithm_name << ": " << result.throughput << " queries/sec, median "
+           << result.median_us << " us, 99th percentile " << result.p99_us << " us" << endl;
+      if (wrong) {
+        cout << "  FAILED: " << wrong << " paths didn't match the optimal cost" << endl;
+        ++ failures;
+      }
+
+      auto found = baseline.find(map_name + " " + algorithm_name);
+      if (update_baseline || found == baseline.end())
+        continue;
+      const BenchResult & base = found->second;
+      if (result.throughput < base.throughput * (1 - threshold)) {
+        cout << "  REGRESSION: throughput " << (1 - result.throughput / base.throughput) * 100
+             << "% below baseline (" << base.throughput << ")" << endl;
+        ++ failures;
+      }
+      if (result.median_us > base.median_us * (1 + threshold)) {
+        cout << "  REGRESSION: median latency " << (result.median_us / base.median_us - 1) * 100
+             << "% above baseline (" << base.median_us << " us)" << endl;
+        ++ failures;
+      }
+      if (result.p99_us > base.p99_us * (1 + threshold)) {
+        cout << "  REGRESSION: 99th percentile latency " << (result.p99_us / base.p99_us - 1) * 100
+             << "% above baseline (" << base.p99_us << " us)" << endl;
+        ++ failures;
+      }
+    }
+    tiled.close();
+    remove(tiled_filename.c_str());
+  }
+
+  if (update_baseline) {
+    ofstream out(baseline_filename.c_str(), ios::out | ios::trunc);
+    out << new_baseline.str();
+    cout << "Wrote " << baseline_filename << endl;
+  }
+  return failures ? 1 : 0;
+}
+
+/// Break the searches' time down by phase, running the workload beside the
+/// map (or a fresh one) on each of `num_threads' threads, each with its own
+/// copy of the map.  Writes the phases as folded stacks to `folded_filename'.
+void benchmark_profile(string map_filename, size_t num_threads, string folded_filename) {
+#ifndef PROFILE_SEARCH
+  cout << "Built without PROFILE_SEARCH; try `make profile'" << endl;
+  (void) map_filename;
+  (void) num_threads;
+  (void) folded_filename;
+#else
+  Workload workload;
+  if (!workload.load(map_filename + ".workload")) {
+    Graph graph;
+    graph.load_ascii_map(map_filename, EDGES_OCTILE);
+    workload.generate(graph, map_filename, RANDOM_SEED, 10, 20);
+  }
+  PhaseProfile::reset();
+  vector<thread> threads;
+  for (size_t tt = 0; tt < num_threads; ++ tt) {
+    threads.push_back(thread([&]() {
+      Graph graph;
+      graph.load_ascii_map(map_filename, EDGES_OCTILE);
+      Stats stats;
+      for (auto& query: workload.queries) {
+        Node * ss = graph.node_at(query.start_x, query.start_y);
+        Node * gg = graph.node_at(query.goal_x, query.goal_y);
+        astar_basic(graph, ss, gg, stats, &octile_heuristic);
+        astar_heap(graph, ss, gg, stats, &octile_heuristic);
+        fringe_search(graph, ss, gg, stats, &octile_heuristic);
+      }
+    }));
+  }
+  for (auto& th: threads)
+    th.join();
+  cout << map_filename << ": " << workload.queries.size() << " queries on " << num_threads
+       << " threads, time by phase:" << endl;
+  PhaseProfile::print_summary();
+  PhaseProfile::write_folded(folded_filename);
+  cout << "Wrote " << folded_filename << endl;
+#endif
+}
+
+/// One-to-all sweeps per second: Dijkstra over the graph's nodes with a heap,
+/// then canonical Dijkstra on one thread and on up to `max_threads' threads.
+void benchmark_canonical_dijkstra(string map_filename, size_t max_threads) {
+  Graph graph;
+  graph.load_ascii_map(map_filename, EDGES_OCTILE);
+  const size_t num_sources = graph.size() > 10000 ? 64 : 512;
+  const size_t cells = (size_t) graph.width * graph.height;
+  Rng rng(RANDOM_SEED);
+  vector<pair<int, int> > sources;
+  for (size_t ii = 0; ii < num_sources; ++ ii) {
+    Node * source = graph.graph_view[rng.below(graph.size())];
+    sources.push_back(make_pair(source->grid_x, source->grid_y));
+  }
+  cout << map_filename << ": " << graph.size() << " cells, " << num_sources << " sources" << endl;
+
+  vector<unsigned int> costs;
+  auto started = chrono::steady_clock::now();
+  for (auto& source: sources)
+    optimal_costs(graph, graph.node_at(source.first, source.second), costs);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+  cout << " Dijkstra over nodes: " << num_sources / seconds << " sweeps/sec" << endl;
+
+  CanonicalDijkstra engine(graph);
+  vector<unsigned int> distances(num_sources * cells);
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    started = chrono::steady_clock::now();
+    engine.sweep_all(sources, distances.data(), threads);
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << " Canonical Dijkstra, " << threads << " thread" << (threads > 1 ? "s" : "") << ": "
+         << num_sources / seconds << " sweeps/sec" << endl;
+  }
+}
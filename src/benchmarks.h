@@ -4,7 +4,15 @@
 #include "heuristics.h"
 
 void benchmark_all_algorithms(Graph & g, int num_problems,
-                              unsigned int (*h)(Node*, Node*), bool print_stats = false);
+                              unsigned int (*h)(Graph&, Node*, Node*), bool print_stats = false);
 void benchmark_grid_costs();
+void benchmark_node_orders(string map_filename);
+void benchmark_hda_star(int dim, size_t max_threads);
+void benchmark_block_astar(string map_filename);
+void benchmark_line_of_sight(string map_filename);
+void benchmark_canonical_dijkstra(string map_filename, size_t max_threads);
+void benchmark_profile(string map_filename, size_t num_threads, string folded_filename);
+int benchmark_workloads(string baseline_filename, double threshold, bool update_baseline);
+void benchmark_tiled_grid(string map_filename, uint32_t tile_size, size_t max_resident);
 
 #endif // BENCHMARKS_H
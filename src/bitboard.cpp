@@ -0,0 +1,109 @@
+#include <algorithm>
+using namespace std;
+#include <cassert>
+#include <cstdlib>
+#include "bitboard.h"
+
+void Bitboard::resize(int width, int height) {
+  assert(width >= 0 && height >= 0);
+  this->width = width;
+  this->height = height;
+  words_per_row = (width + 63) / 64;
+  words_per_column = (height + 63) / 64;
+  rows.assign((size_t) height * words_per_row, 0);
+  columns.assign((size_t) width * words_per_column, 0);
+}
+
+/// Whether bits `from' through `to' (inclusive) of the line starting at word
+/// `first_word' are all set.
+bool Bitboard::run_open(vector<uint64_t> & words, size_t first_word, int from, int to) {
+  const int first = from >> 6, last = to >> 6;
+  const uint64_t first_mask = ~(uint64_t) 0 << (from & 63);
+  const uint64_t last_mask = ~(uint64_t) 0 >> (63 - (to & 63));
+  if (first == last)
+    return (~words[first_word + first] & first_mask & last_mask) == 0;
+  if (~words[first_word + first] & first_mask)
+    return false;
+  for (int ii = first + 1; ii < last; ++ ii)
+    if (~words[first_word + ii])
+      return false;
+  return (~words[first_word + last] & last_mask) == 0;
+}
+
+// Walking along the line's major axis, `along' cells past the first, it moves
+// `across' cells along the minor axis, one diagonal step at a time.  Cells on
+// minor line k run up to major offset run_end(k), and the next run starts one
+// cell further on.  The line is always walked from its smaller major
+// coordinate, so it's the same in both directions.
+static inline int run_end(int k, int along, int across) {
+  if (k == across)
+    return along;
+  return ((long) along * (2 * k + 1) + 2 * across - 1) / (2 * across) - 1;
+}
+
+bool Bitboard::line_of_sight(int x0, int y0, int x1, int y1, bool corner_cut) {
+  assert(x0 >= 0 && y0 >= 0 && x0 < width && y0 < height);
+  assert(x1 >= 0 && y1 >= 0 && x1 < width && y1 < height);
+  const bool x_major = abs(x1 - x0) >= abs(y1 - y0);
+  if (x_major ? x0 > x1 : y0 > y1) {
+    swap(x0, x1);
+    swap(y0, y1);
+  }
+  const int major0 = x_major ? x0 : y0, minor0 = x_major ? y0 : x0;
+  const int along = x_major ? x1 - x0 : y1 - y0;
+  const int across = abs(x_major ? y1 - y0 : x1 - x0);
+  const int step = (x_major ? y1 > y0 : x1 > x0) ? 1 : -1;
+  vector<uint64_t> & words = x_major ? rows : columns;
+  const int stride = x_major ? words_per_row : words_per_column;
+  // Without corner cutting, each diagonal step also needs the cell past the
+  // end of one run and the cell before the start of the next
+  const int pad = corner_cut ? 0 : 1;
+  int from = 0;
+  for (int k = 0; k <= across; ++ k) {
+    const int to = run_end(k, along, across);
+    const int lo = k > 0 ? from - pad : from, hi = k < across ? to + pad : to;
+    if (!run_open(words, (size_t) (minor0 + k * step) * stride, major0 + lo, major0 + hi))
+      return false;
+    from = to + 1;
+  }
+  return true;
+}
+
+bool Bitboard::line_of_sight_cellwise(int x0, int y0, int x1, int y1, bool corner_cut) {
+  static thread_local vector<pair<int, int> > cells;
+  cells.clear();
+  octile_line(x0, y0, x1, y1, cells);
+  for (size_t ii = 0; ii < cells.size(); ++ ii) {
+    if (!get(cells[ii].first, cells[ii].second))
+      return false;
+    if (ii == 0 || corner_cut)
+      continue;
+    const pair<int, int> & prev = cells[ii - 1];
+    if (prev.first != cells[ii].first && prev.second != cells[ii].second &&
+        (!get(cells[ii].first, prev.second) || !get(prev.first, cells[ii].second)))
+      return false;
+  }
+  return true;
+}
+
+void Bitboard::octile_line(int x0, int y0, int x1, int y1, vector<pair<int, int> > & cells) {
+  const bool x_major = abs(x1 - x0) >= abs(y1 - y0);
+  const bool reversed = x_major ? x0 > x1 : y0 > y1;
+  if (reversed) {
+    swap(x0, x1);
+    swap(y0, y1);
+  }
+  const int along = x_major ? x1 - x0 : y1 - y0;
+  const int across = abs(x_major ? y1 - y0 : x1 - x0);
+  const int step = (x_major ? y1 > y0 : x1 > x0) ? 1 : -1;
+  const size_t first = cells.size();
+  int from = 0;
+  for (int k = 0; k <= across; ++ k) {
+    const int to = run_end(k, along, across);
+    for (int ii = from; ii <= to; ++ ii)
+      cells.push_back(x_major ? make_pair(x0 + ii, y0 + k * step) : make_pair(x0 + k * step, y0 + ii));
+    from = to + 1;
+  }
+  if (reversed)
+    reverse(cells.begin() + first, cells.end());
+}
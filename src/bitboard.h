@@ -0,0 +1,58 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+#include <cstdint>
+#include <utility>
+#include <vector>
+using namespace std;
+
+/// One bit per grid cell, set when the cell is open.
+// The bits are packed into 64-bit words twice: once along rows, and once along
+// columns.  A straight octile line is made of runs of cells along one axis, so
+// either copy lets us test a whole run a word at a time.
+class Bitboard {
+ public:
+  Bitboard() { width = height = words_per_row = words_per_column = 0; }
+
+  void resize(int width, int height); // clears every cell
+  void clear() { resize(0, 0); }
+
+  inline bool get(int x, int y) {
+    return rows[y * words_per_row + (x >> 6)] >> (x & 63) & 1;
+  }
+
+  inline void set(int x, int y, bool open) {
+    uint64_t & row_word = rows[y * words_per_row + (x >> 6)];
+    uint64_t & column_word = columns[x * words_per_column + (y >> 6)];
+    if (open) {
+      row_word |= (uint64_t) 1 << (x & 63);
+      column_word |= (uint64_t) 1 << (y & 63);
+    }
+    else {
+      row_word &= ~((uint64_t) 1 << (x & 63));
+      column_word &= ~((uint64_t) 1 << (y & 63));
+    }
+  }
+
+  /// Whether the straight octile line from (x0, y0) to (x1, y1) can be walked:
+  /// every cell on it is open and, unless `corner_cut', so are the two cells
+  /// beside each diagonal step.  Such a line takes max(dx, dy) moves, min(dx,
+  /// dy) of them diagonal, which is as cheap as any path on a uniform grid.
+  bool line_of_sight(int x0, int y0, int x1, int y1, bool corner_cut);
+
+  /// The same test, one cell at a time (for testing and comparison).
+  bool line_of_sight_cellwise(int x0, int y0, int x1, int y1, bool corner_cut);
+
+  /// The cells on the line from (x0, y0) to (x1, y1), in order, ends included.
+  void octile_line(int x0, int y0, int x1, int y1, vector<pair<int, int> > & cells);
+
+  int width, height;
+
+ private:
+  bool run_open(vector<uint64_t> & words, size_t first_word, int from, int to);
+
+  int words_per_row, words_per_column;
+  vector<uint64_t> rows;              // row y starts at word y * words_per_row
+  vector<uint64_t> columns;           // column x starts at word x * words_per_column
+};
+
+#endif // BITBOARD_H
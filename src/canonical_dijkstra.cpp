@@ -0,0 +1,140 @@
+#include <atomic>
+#include <thread>
+using namespace std;
+#include <cassert>
+#include <climits>
+#include "canonical_dijkstra.h"
+
+// Directions 0-3 are cardinal and 4-7 diagonal.
+static const int DX[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+static const int DY[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+/// The direction of the move (dx, dy).
+static inline int direction(int dx, int dy) {
+  static const int directions[3][3] = {{7, 1, 6}, {3, -1, 2}, {5, 0, 4}};
+  return directions[dx + 1][dy + 1];
+}
+
+CanonicalDijkstra::CanonicalDijkstra(Graph & graph) {
+  assert(graph.edge_type == EDGES_OCTILE && graph.min_weight == graph.max_weight);
+  assert(graph.cardinal_cost <= graph.diagonal_cost &&
+         graph.diagonal_cost <= 2 * graph.cardinal_cost);
+  width = graph.width;
+  height = graph.height;
+  cardinal_cost = graph.cardinal_cost * graph.min_weight;
+  diagonal_cost = graph.diagonal_cost * graph.min_weight;
+  corner_cut = graph.corner_cut;
+  stride = width + 2;
+  for (int dd = 0; dd < 8; ++ dd)
+    offsets[dd] = DY[dd] * stride + DX[dd];
+  open.assign((size_t) stride * (height + 2), 0);
+  for (int yy = 0; yy < height; ++ yy)
+    for (int xx = 0; xx < width; ++ xx)
+      open[(yy + 1) * stride + xx + 1] = graph.node_at(xx, yy) != 0;
+}
+
+size_t CanonicalDijkstra::sweep(int x, int y, unsigned int * distances) {
+  assert(x >= 0 && y >= 0 && x < width && y < height);
+  // Per-thread scratch space, in padded grid order
+  static thread_local vector<unsigned int> dist;
+  static thread_local vector<uint8_t> arrivals;  // bit d: reached by a move in direction d
+  static thread_local vector<vector<uint32_t> > buckets;
+  dist.assign(open.size(), UINT_MAX);
+  arrivals.assign(open.size(), 0);
+  buckets.resize(diagonal_cost + 1);
+  for (auto& bucket: buckets)
+    bucket.clear();
+
+  size_t expanded = 0, queued = 0;
+  const uint32_t source = (y + 1) * stride + x + 1;
+  if (open[source]) {
+    dist[source] = 0;
+    arrivals[source] = 0xff;          // a source may go anywhere
+    buckets[0].push_back(source);
+    queued = 1;
+  }
+  for (unsigned int g = 0; queued > 0; ++ g) {
+    vector<uint32_t> & bucket = buckets[g % buckets.size()];
+    for (size_t ii = 0; ii < bucket.size(); ++ ii) {
+      const uint32_t here = bucket[ii];
+      -- queued;
+      if (dist[here] != g)
+        continue;                     // improved since it was queued
+      ++ expanded;
+
+      // Collect the canonical (and forced) successors of each arrival
+      unsigned int successors = 0;
+      for (int dd = 0; dd < 8; ++ dd) {
+        if (!(arrivals[here] >> dd & 1))
+          continue;
+        successors |= 1 << dd;
+        if (dd < 4) {
+          // A wall beside the way we came forces a turn toward it
+          for (int side = dd < 2 ? 2 : 0; side < (dd < 2 ? 4 : 2); ++ side) {
+            const int turn = direction(DX[dd] + DX[side], DY[dd] + DY[side]);
+            if (corner_cut) {
+              if (!open[here + offsets[side]])
+                successors |= 1 << turn;
+            }
+            else if (!open[here - offsets[dd] + offsets[side]] && open[here + offsets[side]])
+              successors |= 1 << side | 1 << turn;
+          }
+        }
+        else {
+          const int along_x = direction(DX[dd], 0), along_y = direction(0, DY[dd]);
+          successors |= 1 << along_x | 1 << along_y;
+          if (corner_cut) {
+            if (!open[here - offsets[along_x]])
+              successors |= 1 << direction(-DX[dd], DY[dd]);
+            if (!open[here - offsets[along_y]])
+              successors |= 1 << direction(DX[dd], -DY[dd]);
+          }
+        }
+      }
+
+      for (int dd = 0; dd < 8; ++ dd) {
+        if (!(successors >> dd & 1))
+          continue;
+        const uint32_t there = here + offsets[dd];
+        if (!open[there])
+          continue;
+        if (dd >= 4 && !corner_cut &&
+            (!open[here + DX[dd]] || !open[here + DY[dd] * stride]))
+          continue;
+        const unsigned int cost = g + (dd < 4 ? cardinal_cost : diagonal_cost);
+        if (cost < dist[there]) {
+          dist[there] = cost;
+          arrivals[there] = 1 << dd;
+          buckets[cost % buckets.size()].push_back(there);
+          ++ queued;
+        }
+        else if (cost == dist[there])
+          arrivals[there] |= 1 << dd;
+      }
+    }
+    bucket.clear();
+  }
+
+  for (int yy = 0; yy < height; ++ yy)
+    for (int xx = 0; xx < width; ++ xx)
+      distances[yy * width + xx] = dist[(yy + 1) * stride + xx + 1];
+  return expanded;
+}
+
+/// Worker threads take the next unswept source until there are none left.
+void CanonicalDijkstra::sweep_all(const vector<pair<int, int> > & sources,
+                                  unsigned int * distances, size_t num_threads) {
+  assert(num_threads > 0);
+  const size_t cells = (size_t) width * height;
+  atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t ii = next++; ii < sources.size(); ii = next++)
+      sweep(sources[ii].first, sources[ii].second, distances + ii * cells);
+  };
+  vector<thread> threads;
+  for (size_t tt = 1; tt < num_threads; ++ tt)
+    threads.push_back(thread(worker));
+  worker();
+  for (auto& th: threads)
+    th.join();
+}
@@ -0,0 +1,51 @@
+#ifndef CANONICAL_DIJKSTRA_H
+#define CANONICAL_DIJKSTRA_H
+#include <cstdint>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#include "graph.h"
+
+/// One-to-all shortest paths on an octile grid of uniform weight, with
+/// Dijkstra's algorithm restricted to a canonical ordering (Sturtevant and
+/// Rabin '16).
+// Among the many equally short paths on a grid, canonical paths make their
+// diagonal moves before their cardinal ones.  So a cell reached by a cardinal
+// move only carries on in that direction, and a cell reached diagonally only
+// carries on diagonally or along that diagonal's two cardinal directions,
+// unless an obstacle beside the path forces a turn (as in Jump Point Search).
+// Each cell is then reached from just one or two parents rather than from all
+// of its neighbors.  The frontier is a circular array of buckets, one per
+// path cost, since no move costs more than a diagonal move.
+//
+// The engine takes a snapshot of the graph's cells (later edits need a new
+// engine), and it can be shared by any number of threads.
+class CanonicalDijkstra {
+ public:
+  /// Needs an octile graph of uniform weight whose diagonal moves cost from
+  /// one to two cardinal moves, and whose edges follow its cells.
+  CanonicalDijkstra(Graph & graph);
+
+  /// Write the cost of a shortest path from (x, y) to every cell into
+  /// `distances', in grid order (y * width + x); UINT_MAX where there's none.
+  /// Returns how many cells were expanded.
+  size_t sweep(int x, int y, unsigned int * distances);
+
+  /// Sweep from each of `sources' on `num_threads' threads, writing the
+  /// distances of source i at distances + i * width * height.
+  void sweep_all(const vector<pair<int, int> > & sources, unsigned int * distances,
+                 size_t num_threads);
+
+  int width, height;
+  unsigned int cardinal_cost, diagonal_cost;   // weight included
+  bool corner_cut;
+
+ private:
+  char reserved[3];
+  int stride;                         // width + 2
+  int offsets[8];                     // to the neighbor in each direction
+  vector<uint8_t> open;               // padded with a blocked border
+};
+
+#endif // CANONICAL_DIJKSTRA_H
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -14,6 +15,8 @@ Node::Node() {
   this->g = 0;
   this->glyph = 0;
   this->heap_index = -1;
+  this->graph_index = -1;
+  this->version = 0;
 }
 
 string Node::to_str(bool verbose) {
@@ -43,19 +46,94 @@ void Node::expand(int problem_id) {
   this->open = false;
 }
 
+Graph::Graph() {
+  this->width = 0;
+  this->height = 0;
+  this->edge_type = EDGES_DEFAULT;
+  this->version = 0;
+  this->corner_cut = false;
+  this->cardinal_cost = 2;
+  this->diagonal_cost = 3;
+  this->min_weight = 1;
+  this->max_weight = 1;
+  // Terrain glyphs follow the movingai.com conventions where they overlap
+  this->terrain.assign(256, 0);
+  set_terrain('.', 1);               // passable terrain
+  set_terrain('G', 1);               // passable terrain
+  set_terrain('S', 3);               // swamp
+}
+
+/// A deep copy, packed in the same order as `other.graph_view' (see reorder),
+/// with none of other's pending edits or search state.
+Graph::Graph(const Graph & other) {
+  edge_type = other.edge_type;
+  width = other.width;
+  height = other.height;
+  version = other.version;
+  corner_cut = other.corner_cut;
+  cardinal_cost = other.cardinal_cost;
+  diagonal_cost = other.diagonal_cost;
+  min_weight = other.min_weight;
+  max_weight = other.max_weight;
+  terrain = other.terrain;
+  cell_weights = other.cell_weights;
+  passable = other.passable;
+  grid_view.assign(other.grid_view.size(), 0);
+  graph_view.resize(other.graph_view.size());
+  pack(other.graph_view);
+}
+
 void Graph::clear() {
   for (auto& nd: graph_view)
-    delete nd;
+    if (!packed(nd))
+      delete nd;
+  packed_nodes.clear();
+  packed_out.clear();
+  packed_in.clear();
+  packed_costs.clear();
   grid_view.clear();
   graph_view.clear();
+  cell_weights.clear();
+  passable.clear();
+  pending_edits.clear();
   width = 0;
   height = 0;
 }
 
+/// The cost of moving between two adjacent nodes.  The search routines read
+/// the precomputed costs_out instead; this is for validation and setup.
+unsigned int Graph::cost(Node* n1, Node* n2) {
+  const bool cardinal = n1->grid_x == n2->grid_x || n1->grid_y == n2->grid_y;
+  unsigned int move_cost;
+  if (edge_type == EDGES_QUARTILE)
+    move_cost = cardinal ? 1 : 2;
+  else
+    move_cost = cardinal ? cardinal_cost : diagonal_cost;
+  return move_cost * (cell_weights[n1->grid_y * width + n1->grid_x] +
+                      cell_weights[n2->grid_y * width + n2->grid_x]) / 2;
+}
+
+void Graph::grid_costs(int new_cardinal_cost, int new_diagonal_cost) {
+  assert(new_cardinal_cost > 0 && new_diagonal_cost > 0);
+  cardinal_cost = new_cardinal_cost;
+  diagonal_cost = new_diagonal_cost;
+  compute_edge_costs();
+}
+
+/// Set the weight of a terrain glyph for subsequent calls to load_ascii_map.
+/// A weight of zero makes the glyph impassable.
+void Graph::set_terrain(char glyph, unsigned int weight) {
+  assert(weight <= MAX_WEIGHT);
+  terrain[(unsigned char) glyph] = weight;
+}
+
 /// Load an ascii map.  Note this assumes the same file format as
 /// Nathan Sturtevant's Benchmarks for Grid-Based Pathfinding (2012).
 /// See: http://www.movingai.com/benchmarks/formats.html
-void Graph::load_ascii_map(string filename, EdgeType edge_type, bool corner_cut, bool verbose) {
+/// Glyphs are weighted according to `terrain' (see set_terrain).  Unless
+/// `order' is ORDER_NONE, the nodes are then laid out in that order (see reorder).
+void Graph::load_ascii_map(string filename, EdgeType edge_type, bool corner_cut, bool verbose,
+                           NodeOrder order) {
   clear();
   ifstream map_file(filename.c_str(), ios::in);
   assert(map_file.good());
@@ -75,26 +153,28 @@ void Graph::load_ascii_map(string filename, EdgeType edge_type, bool corner_cut,
   }
   int xx = 0, yy = 0;
   string row;
+  passable.resize(width, height);
+  min_weight = 0;
+  max_weight = 0;
   for (yy = 0; yy < height; ++ yy) {
     map_file >> row;
     for (xx = 0; xx < width; ++ xx) {
-      if (row[xx] == '.') {
-        Node * node = new Node();
-        node->grid_x = xx;
-        node->grid_y = yy;
-        node->g = 0;
-        node->f = 0;
-        node->glyph = 0;
-        node->open = 0;
-        node->closed_id = 0;
-        graph_view.push_back(node);
-        grid_view.push_back(node);
+      const unsigned int weight = terrain[(unsigned char) row[xx]];
+      cell_weights.push_back(weight);
+      if (weight) {
+        if (!min_weight || weight < min_weight)
+          min_weight = weight;
+        if (weight > max_weight)
+          max_weight = weight;
+        grid_view.push_back(add_node(xx, yy));
       }
       else
         grid_view.push_back(0);
     }
   }
   map_file.close();
+  if (!min_weight)
+    min_weight = max_weight = 1;
 
   // Connect up the neighbors
   size_t edges;
@@ -104,16 +184,15 @@ void Graph::load_ascii_map(string filename, EdgeType edge_type, bool corner_cut,
     else
       edges = add_quartile_edges();
   }
-  else if (edge_type == EDGES_OCTILE) {
+  else if (edge_type == EDGES_OCTILE)
     edges = add_octile_edges(corner_cut);
-    this->cost = &octile_cost;
-  }
-  else {
+  else
     edges = add_quartile_edges();
-    this->cost = &man_cost;
-  }
+  compute_edge_costs();
+  reorder(order);
   if (verbose) {
-    cout << filename << ": " << graph_view.size() << " nodes, " << edges << " edges" << endl;
+    cout << filename << ": " << graph_view.size() << " nodes, " << edges << " edges, "
+         << "terrain weights " << min_weight << "-" << max_weight << endl;
   }
 }
 
@@ -121,27 +200,143 @@ void Graph::load_empty_map(int dim1, int dim2, EdgeType edge_type) {
   assert(dim1 > 0 && dim2 > 0);
   this->height = dim1;
   this->width = dim2;
+  this->min_weight = 1;
+  this->max_weight = 1;
+  this->cell_weights.assign(dim1 * dim2, 1);
+  this->passable.resize(dim2, dim1);
   for (int yy = 0; yy < this->height; ++ yy) {
-    for (int xx = 0; xx < this->width; ++ xx) {
-      Node * node = new Node();
-      node->grid_x = xx;
-      node->grid_y = yy;
-      graph_view.push_back(node);
-      grid_view.push_back(node);
-    }
+    for (int xx = 0; xx < this->width; ++ xx)
+      grid_view.push_back(add_node(xx, yy));
   }
   size_t edges;
-  if (edge_type == EDGES_DEFAULT || edge_type == EDGES_OCTILE) {
+  if (edge_type == EDGES_DEFAULT || edge_type == EDGES_OCTILE)
     edges = add_octile_edges();
-    cost = &octile_cost;
-  }
-  else {
+  else
     edges = add_quartile_edges();
-    cost = &man_cost;
-  }
+  compute_edge_costs();
   cout << "Empty map:" << graph_view.size() << " nodes, " << edges << " edges" << endl;
 }
 
+/// Position of a cell along a Z-order curve: interleave the bits of x and y.
+inline uint64_t morton_key(uint32_t x, uint32_t y) {
+  uint64_t key = 0;
+  for (int bit = 0; bit < 32; ++ bit) {
+    key |= (uint64_t) ((x >> bit) & 1) << (2 * bit);
+    key |= (uint64_t) ((y >> bit) & 1) << (2 * bit + 1);
+  }
+  return key;
+}
+
+/// Position of a cell along a Hilbert curve filling a side x side square,
+/// where side is a power of two.
+inline uint64_t hilbert_key(uint32_t side, uint32_t x, uint32_t y) {
+  uint64_t key = 0;
+  for (uint32_t half = side / 2; half > 0; half /= 2) {
+    const uint32_t rx = (x & half) > 0, ry = (y & half) > 0;
+    key += (uint64_t) half * half * ((3 * rx) ^ ry);
+    if (ry == 0) {                    // rotate the quadrant
+      if (rx == 1) {
+        x = side - 1 - x;
+        y = side - 1 - y;
+      }
+      swap(x, y);
+    }
+  }
+  return key;
+}
+
+const int ORDER_BLOCK_SIZE = 8;
+
+/// Renumber the nodes along a space-filling curve (or in small square blocks)
+/// so that nodes that are near each other on the map are near each other in
+/// memory.
+// Row-major order puts vertical neighbors `width' nodes apart, so a search
+// frontier growing in 2D keeps missing the cache.  We sort graph_view by curve
+// position, copy the nodes into one array in that order (packed_nodes), and
+// pack their edge lists into flat arrays in the same order.  graph_index
+// follows the new order, so per-search arrays indexed by it (as in hda_star)
+// do too.  grid_view still maps coordinates to nodes.
+void Graph::reorder(NodeOrder order) {
+  if (order == ORDER_NONE)
+    return;
+  uint32_t side = 1;
+  while (side < width || side < height)
+    side *= 2;
+  const uint32_t blocks_x = (width + ORDER_BLOCK_SIZE - 1) / ORDER_BLOCK_SIZE;
+  vector<pair<uint64_t, Node*> > keyed;
+  for (auto& node: graph_view) {
+    const uint32_t x = node->grid_x, y = node->grid_y;
+    uint64_t key;
+    if (order == ORDER_MORTON)
+      key = morton_key(x, y);
+    else if (order == ORDER_HILBERT)
+      key = hilbert_key(side, x, y);
+    else if (order == ORDER_BLOCKS)
+      key = ((uint64_t) (y / ORDER_BLOCK_SIZE) * blocks_x + x / ORDER_BLOCK_SIZE) *
+        ORDER_BLOCK_SIZE * ORDER_BLOCK_SIZE + (y % ORDER_BLOCK_SIZE) * ORDER_BLOCK_SIZE +
+        x % ORDER_BLOCK_SIZE;
+    else
+      key = (uint64_t) y * width + x;
+    keyed.push_back(make_pair(key, node));
+  }
+  sort(keyed.begin(), keyed.end());
+  vector<Node*> ordered, unpacked;
+  for (size_t ii = 0; ii < keyed.size(); ++ ii) {
+    keyed[ii].second->graph_index = ii;
+    ordered.push_back(keyed[ii].second);
+    if (!packed(keyed[ii].second))
+      unpacked.push_back(keyed[ii].second);
+  }
+  pack(ordered);
+  for (auto& node: unpacked)
+    delete node;
+}
+
+/// Lay copies of the nodes in `order' out in packed_nodes, with their edge
+/// lists back to back, and point graph_view and grid_view at the copies.  Each
+/// node's graph_index must be its position in `order'.  The copies start with
+/// fresh search state.  The previously packed storage is freed; unpacked nodes
+/// are left to the caller.
+void Graph::pack(const vector<Node*> & order) {
+  size_t num_out = 0, num_in = 0;
+  for (auto& node: order) {
+    num_out += node->neighbors_out.size();
+    num_in += node->neighbors_in.size();
+  }
+  vector<Node> nodes(order.size());
+  vector<Node*> out(num_out), in(num_in);
+  vector<unsigned int> costs(num_out);
+  num_out = num_in = 0;
+  for (size_t ii = 0; ii < order.size(); ++ ii) {
+    const Node & from = *order[ii];
+    Node & node = nodes[ii];
+    node.grid_x = from.grid_x;
+    node.grid_y = from.grid_y;
+    node.graph_index = ii;
+    node.version = from.version;
+    node.glyph = from.glyph;
+    node.neighbors_out.pack(out.data() + num_out, from.neighbors_out);
+    node.costs_out.pack(costs.data() + num_out, from.costs_out);
+    node.neighbors_in.pack(in.data() + num_in, from.neighbors_in);
+    num_out += node.neighbors_out.size();
+    num_in += node.neighbors_in.size();
+    grid_view[node.grid_y * width + node.grid_x] = &node;
+  }
+  // The copied neighbor lists still point at the old nodes; translate them
+  for (auto& neighbor: out)
+    neighbor = &nodes[neighbor->graph_index];
+  for (auto& neighbor: in)
+    neighbor = &nodes[neighbor->graph_index];
+
+  // Swapping keeps the new nodes and edge arrays where they are
+  packed_nodes.swap(nodes);
+  packed_out.swap(out);
+  packed_in.swap(in);
+  packed_costs.swap(costs);
+  for (size_t ii = 0; ii < packed_nodes.size(); ++ ii)
+    graph_view[ii] = &packed_nodes[ii];
+}
+
 void Graph::display_ascii_map() {
   for (int yy = 0; yy < this->height; ++ yy) {
     for (int xx = 0; xx < this->width; ++ xx) {
@@ -171,6 +366,7 @@ void Graph::display_ascii_path(Node * ss, Node * gg) {
 size_t Graph::add_octile_edges(bool corner_cut) {
   size_t edges = 0;
   this->edge_type = EDGES_OCTILE;
+  this->corner_cut = corner_cut;
   for (size_t ii = 0; ii < graph_view.size(); ++ ii) {
     for (size_t jj = ii + 1; jj <= ii + width + 1 && jj < graph_view.size(); ++ jj) {
       if ((abs(graph_view[ii]->grid_x - graph_view[jj]->grid_x) <= 1) &&
@@ -230,6 +426,15 @@ size_t Graph::add_quartile_edges() {
   return edges;
 }
 
+/// Fill in each node's costs_out, aligned with its neighbors_out.
+void Graph::compute_edge_costs() {
+  for (auto& node: graph_view) {
+    node->costs_out.resize(node->neighbors_out.size());
+    for (size_t ii = 0; ii < node->neighbors_out.size(); ++ ii)
+      node->costs_out[ii] = cost(node, node->neighbors_out[ii]);
+  }
+}
+
 void Graph::remove_edge(Node * from, Node * to) {
   int out_index = -1, in_index = -1;
   for (size_t ii = 0; ii < from->neighbors_out.size(); ++ ii) {
@@ -246,6 +451,126 @@ void Graph::remove_edge(Node * from, Node * to) {
   }
   from->neighbors_out[out_index] = from->neighbors_out.back();
   from->neighbors_out.pop_back();
+  if (!from->costs_out.empty()) {
+    from->costs_out[out_index] = from->costs_out.back();
+    from->costs_out.pop_back();
+  }
   to->neighbors_in[in_index] = to->neighbors_in.back();
   to->neighbors_in.pop_back();
 }
+
+Node * Graph::add_node(int x, int y) {
+  Node * node = new Node();
+  node->grid_x = x;
+  node->grid_y = y;
+  node->graph_index = graph_view.size();
+  node->version = version;
+  graph_view.push_back(node);
+  passable.set(x, y, true);
+  return node;
+}
+
+/// Delete a node (one in packed_nodes is just left there), swapping the last
+/// node into its slot in graph_view.  Its edges must be cleaned up separately
+/// (see commit_edits).
+void Graph::remove_node(Node * node) {
+  Node * moved = graph_view.back();
+  graph_view[node->graph_index] = moved;
+  moved->graph_index = node->graph_index;
+  graph_view.pop_back();
+  grid_view[node->grid_y * width + node->grid_x] = 0;
+  passable.set(node->grid_x, node->grid_y, false);
+  if (!packed(node))
+    delete node;
+}
+
+/// Regenerate a node's edges from its current neighborhood, applying the same
+/// rules as add_octile_edges and add_quartile_edges.
+void Graph::rebuild_edges(Node * node) {
+  static const int dirs[8][2] = {{0, -1}, {-1, 0}, {1, 0}, {0, 1},
+                                 {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+  const int num_dirs = edge_type == EDGES_QUARTILE ? 4 : 8;
+  node->neighbors_out.clear();
+  node->costs_out.clear();
+  node->neighbors_in.clear();
+  node->version = version;
+  for (int ii = 0; ii < num_dirs; ++ ii) {
+    const int xx = node->grid_x + dirs[ii][0], yy = node->grid_y + dirs[ii][1];
+    if (!in_bounds(xx, yy) || !node_at(xx, yy))
+      continue;
+    // Diagonal moves need both adjacent cardinal cells open unless cutting corners
+    if (ii >= 4 && !corner_cut && (!node_at(xx, node->grid_y) || !node_at(node->grid_x, yy)))
+      continue;
+    Node * neighbor = node_at(xx, yy);
+    node->neighbors_out.push_back(neighbor);
+    node->costs_out.push_back(cost(node, neighbor));
+    node->neighbors_in.push_back(neighbor);
+  }
+}
+
+void Graph::set_blocked(int x, int y) {
+  assert(in_bounds(x, y));
+  MapEdit edit = {x, y, 0};
+  pending_edits.push_back(edit);
+}
+
+void Graph::set_open(int x, int y, unsigned int weight) {
+  assert(in_bounds(x, y) && weight > 0 && weight <= MAX_WEIGHT);
+  MapEdit edit = {x, y, weight};
+  pending_edits.push_back(edit);
+}
+
+/// Apply all pending edits and return the new version.
+// Whether a diagonal edge exists depends on the two cells beside it, so an
+// edit can only change edges whose endpoints both lie in the edited cell's
+// 3x3 neighborhood.  We update the cells first and then rebuild the edges of
+// each node in the union of those neighborhoods, once.
+unsigned int Graph::commit_edits() {
+  if (pending_edits.empty())
+    return version;
+  ++ version;
+  vector<size_t> touched;
+  bool rescan = false;                // whether a cell of the smallest or largest weight changed
+  for (auto& edit: pending_edits) {
+    const size_t index = edit.y * width + edit.x;
+    Node * node = grid_view[index];
+    if (cell_weights[index] != edit.weight &&
+        (cell_weights[index] == min_weight || cell_weights[index] == max_weight))
+      rescan = true;
+    cell_weights[index] = edit.weight;
+    if (!edit.weight && node)
+      remove_node(node);
+    else if (edit.weight && !node)
+      grid_view[index] = add_node(edit.x, edit.y);
+    if (edit.weight && edit.weight < min_weight)
+      min_weight = edit.weight;
+    if (edit.weight > max_weight)
+      max_weight = edit.weight;
+    for (int yy = edit.y - 1; yy <= edit.y + 1; ++ yy)
+      for (int xx = edit.x - 1; xx <= edit.x + 1; ++ xx)
+        if (in_bounds(xx, yy))
+          touched.push_back(yy * width + xx);
+  }
+  pending_edits.clear();
+  // The bounds may have narrowed (say the last swamp was drained), and the
+  // heuristics and direct paths are only as good as the bounds are tight
+  if (rescan) {
+    min_weight = max_weight = 0;
+    for (auto& weight: cell_weights) {
+      if (weight && (!min_weight || weight < min_weight))
+        min_weight = weight;
+      if (weight > max_weight)
+        max_weight = weight;
+    }
+    if (!min_weight)
+      min_weight = max_weight = 1;
+  }
+
+  sort(touched.begin(), touched.end());
+  touched.erase(unique(touched.begin(), touched.end()), touched.end());
+  for (auto& index: touched) {
+    if (grid_view[index])
+      rebuild_edges(grid_view[index]);
+  }
+  return version;
+}
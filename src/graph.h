@@ -1,19 +1,121 @@
 #ifndef GRIDWORLD_H
 #define GRIDWORLD_H
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <list>
 using namespace std;
 
+#include <cstdint>
 #include <cstdlib>
+#include "bitboard.h"
 
 enum EdgeType { EDGES_DEFAULT, EDGES_OCTILE, EDGES_QUARTILE };
+// ORDER_NONE leaves the nodes where they were allocated (see Graph::reorder).
+enum NodeOrder { ORDER_ROW_MAJOR, ORDER_MORTON, ORDER_HILBERT, ORDER_BLOCKS, ORDER_NONE };
+
+/// The largest terrain weight.  Tiled grids store weights in a byte, and the
+/// bound keeps edge costs and g values far from overflowing an int.
+const unsigned int MAX_WEIGHT = 255;
+
+/// A pending change to one cell of the map (see Graph::commit_edits).
+struct MapEdit {
+  int x, y;
+  unsigned int weight;                // terrain weight; 0 blocks the cell
+};
+
+/// One of a node's edge lists.  It works like a vector, except that
+/// Graph::reorder can pack the lists of every node into flat arrays owned by
+/// the graph; a packed list moves back out to storage of its own the first
+/// time it grows.  It's kept to a pointer and two counts, since every Node
+/// carries three.
+template <class T>
+class EdgeList {
+ public:
+  EdgeList() {
+    first = 0;
+    count = capacity = 0;
+  }
+  EdgeList(const EdgeList & other) {
+    first = 0;
+    count = capacity = 0;
+    *this = other;
+  }
+  EdgeList & operator=(const EdgeList & other) {
+    if (this != &other) {
+      count = 0;
+      reserve(other.count);
+      copy(other.begin(), other.end(), first);
+      count = other.count;
+    }
+    return *this;
+  }
+  ~EdgeList() {
+    if (capacity)
+      delete[] first;
+  }
+
+  inline size_t size() const { return count; }
+  inline bool empty() const { return count == 0; }
+  inline T & operator[](size_t ii) { return first[ii]; }
+  inline const T & operator[](size_t ii) const { return first[ii]; }
+  inline T * begin() { return first; }
+  inline T * end() { return first + count; }
+  inline const T * begin() const { return first; }
+  inline const T * end() const { return first + count; }
+  inline T & back() { return first[count - 1]; }
+
+  void push_back(const T & value) {
+    if (count == capacity)
+      reserve(max<size_t>(4, 2 * count));
+    first[count ++] = value;
+  }
+  inline void pop_back() { -- count; }
+  inline void clear() { count = 0; }
+  void resize(size_t size) {
+    if (size > count) {
+      reserve(size);
+      fill(first + count, first + size, T());
+    }
+    count = size;
+  }
+
+  /// Copy the list `from' to `where', and keep it there from now on.
+  void pack(T * where, const EdgeList & from) {
+    copy(from.begin(), from.end(), where);
+    if (capacity)
+      delete[] first;
+    first = where;
+    count = from.count;
+    capacity = 0;
+  }
+
+ private:
+  /// Make sure the list has storage of its own for `size' entries.
+  void reserve(size_t size) {
+    if (capacity && size <= capacity)
+      return;
+    T * owned = new T[size ? size : 1];
+    copy(begin(), end(), owned);
+    if (capacity)
+      delete[] first;
+    first = owned;
+    capacity = size ? size : 1;
+  }
+
+  T * first;
+  uint32_t count;
+  uint32_t capacity;                  // 0 if the storage isn't ours (packed, or none)
+};
 
 class Node {
  public:
-  vector<Node*> neighbors_out;
-  vector<Node*> neighbors_in;
+  EdgeList<Node*> neighbors_out;
+  EdgeList<unsigned int> costs_out;   // cost of each edge in neighbors_out
+  EdgeList<Node*> neighbors_in;
   int grid_x, grid_y;
+  int graph_index;                    // location in Graph::graph_view
+  unsigned int version;               // graph version of the last edit to its edges
 
   // pathfinding variables
   int g, f;                           // recorded g and f costs
@@ -33,32 +135,81 @@ class Node {
 
 class Graph {
  public:
-  Graph() { this->cost = 0; }
+  Graph();
+  Graph(const Graph & other);
+  Graph & operator=(const Graph &) = delete;
   ~Graph() { this->clear(); }
   void clear();
 
   EdgeType edge_type;
   unsigned short width, height;
-  unsigned int (*cost)(Node*, Node*);
+  unsigned int version;          // bumped by each commit_edits()
+  bool corner_cut;               // whether diagonal moves may cut corners
+  char reserved[3];
+
+  // Move costs.  An edge costs its cardinal or diagonal move cost, times the
+  // mean terrain weight of its two endpoints (so unit weights cost the same as
+  // an unweighted grid).  Heuristics are scaled by the smallest weight present.
+  int cardinal_cost, diagonal_cost;
+  unsigned int min_weight, max_weight;
+  vector<unsigned int> terrain;      // weight of each map glyph; 0 is blocked
+  vector<unsigned int> cell_weights; // weight of each cell, in grid order
+  Bitboard passable;                 // which cells have a node
 
   vector<Node*> graph_view;
   vector<Node*> grid_view;       // contains nulls
+  vector<MapEdit> pending_edits;
+
+  // Storage laid out by reorder: the nodes in graph_index order, and their
+  // edge lists back to back in the same order.  Nodes added since are
+  // allocated one at a time.
+  vector<Node> packed_nodes;
+  vector<Node*> packed_out, packed_in;
+  vector<unsigned int> packed_costs;
 
   inline size_t size() { return graph_view.size(); }
+  inline bool packed(Node * node) {
+    return !packed_nodes.empty() && node >= &packed_nodes.front() && node <= &packed_nodes.back();
+  }
   void print_stats();
 
+  inline bool in_bounds(long x, long y) { return x >= 0 && y >= 0 && x < width && y < height; }
   inline Node * node_at(int x, int y) { return grid_view[y * width + x]; }
   inline Node * random_node() { return graph_view[rand() % graph_view.size()]; }
+  inline bool line_of_sight(Node * n1, Node * n2) {
+    return passable.line_of_sight(n1->grid_x, n1->grid_y, n2->grid_x, n2->grid_y, corner_cut);
+  }
 
-  void load_ascii_map(string filename, EdgeType edge_type = EDGES_DEFAULT, bool corner_cut = false, bool verbose = false);
+  unsigned int cost(Node*, Node*);
+  void grid_costs(int new_cardinal_cost, int new_diagonal_cost);
+  void set_terrain(char glyph, unsigned int weight);
+
+  void load_ascii_map(string filename, EdgeType edge_type = EDGES_DEFAULT, bool corner_cut = false,
+                      bool verbose = false, NodeOrder order = ORDER_NONE);
   void load_empty_map(int dim1, int dim2, EdgeType edge_type = EDGES_DEFAULT);
 
+  void reorder(NodeOrder order);
+
   void display_ascii_map();
   void display_ascii_path(Node*, Node*);
 
+  // Runtime map edits.  set_blocked and set_open queue up an edit; the queue is
+  // applied by commit_edits, which rebuilds only the edges in the 3x3
+  // neighborhood of each edited cell and bumps `version'.
+  void set_blocked(int x, int y);
+  void set_open(int x, int y, unsigned int weight = 1);
+  unsigned int commit_edits();
+
   size_t add_octile_edges(bool corner_cut = false);
   size_t add_quartile_edges();
+  void compute_edge_costs();
   void remove_edge(Node*, Node*);
+
+ private:
+  Node * add_node(int x, int y);
+  void remove_node(Node*);
+  void rebuild_edges(Node*);
+  void pack(const vector<Node*> & order);
 };
 
 #endif // GRIDWORLD_H
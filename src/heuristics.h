@@ -2,19 +2,15 @@
 #define HEURISTICS_H
 
 class Node;
+class Graph;
 
-// Cost functions
-void grid_costs(int new_cardinal_cost, int new_diagonal_cost);
-unsigned int inf_cost(Node*, Node*);
-unsigned int man_cost(Node*, Node*);
-unsigned int octile_cost(Node*, Node*);
-
-// Heuristic functions
-unsigned int zero_heuristic(Node*, Node*);
-unsigned int man_heuristic(Node*, Node*);
-unsigned int inf_heuristic(Node*, Node*);
-unsigned int octile_heuristic(Node*, Node*);
-unsigned int octile_heuristic_no_branch(Node*, Node*);
-unsigned int weighted_octile_heuristic(Node*, Node*);
+// Heuristic functions.  Move costs and terrain weights are read from the graph
+// (see Graph::grid_costs and Graph::set_terrain).
+unsigned int zero_heuristic(Graph&, Node*, Node*);
+unsigned int man_heuristic(Graph&, Node*, Node*);
+unsigned int inf_heuristic(Graph&, Node*, Node*);
+unsigned int octile_heuristic(Graph&, Node*, Node*);
+unsigned int octile_heuristic_no_branch(Graph&, Node*, Node*);
+unsigned int weighted_octile_heuristic(Graph&, Node*, Node*);
 
 #endif // HEURISTICS_H
@@ -0,0 +1,123 @@
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+using namespace std;
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include "lddb.h"
+
+const char LDDB_MAGIC[4] = {'L', 'D', 'D', 'B'};
+
+const int LocalDistanceDatabase::BLOCK_SIZE;
+const int LocalDistanceDatabase::CELLS;
+const uint16_t LocalDistanceDatabase::UNREACHABLE;
+
+LocalDistanceDatabase & LocalDistanceDatabase::cached(int cardinal_cost, int diagonal_cost,
+                                                      bool corner_cut, string directory) {
+  static mutex lock;
+  static map<tuple<int, int, bool>, LocalDistanceDatabase> databases;
+  lock_guard<mutex> guard(lock);
+  LocalDistanceDatabase & lddb =
+    databases[make_tuple(cardinal_cost, diagonal_cost, corner_cut)];
+  if (!lddb.distances.empty())
+    return lddb;
+  lddb.cardinal_cost = cardinal_cost;
+  lddb.diagonal_cost = diagonal_cost;
+  lddb.corner_cut = corner_cut;
+  if (!lddb.load(lddb.filename(directory))) {
+    lddb.build(cardinal_cost, diagonal_cost, corner_cut);
+    lddb.save(lddb.filename(directory));
+  }
+  return lddb;
+}
+
+string LocalDistanceDatabase::filename(string directory) {
+  stringstream name;
+  name << directory << "/lddb_" << BLOCK_SIZE << "_" << cardinal_cost << "_"
+       << diagonal_cost << (corner_cut ? "_cut" : "") << ".lddb";
+  return name.str();
+}
+
+/// Run Dijkstra from every open cell of every pattern.  The blocks are tiny,
+/// so a linear scan for the closest cell beats a heap.
+void LocalDistanceDatabase::build(int cardinal_cost, int diagonal_cost, bool corner_cut) {
+  assert(cardinal_cost > 0 && diagonal_cost > 0);
+  this->cardinal_cost = cardinal_cost;
+  this->diagonal_cost = diagonal_cost;
+  this->corner_cut = corner_cut;
+  this->loaded_from_disk = false;
+  const uint32_t num_patterns = 1 << CELLS;
+  distances.assign((size_t) num_patterns * CELLS * CELLS, UNREACHABLE);
+
+  for (uint32_t pattern = 0; pattern < num_patterns; ++ pattern) {
+    for (int source = 0; source < CELLS; ++ source) {
+      if (!(pattern & (1 << source)))
+        continue;
+      uint16_t * dist = &distances[(pattern * CELLS + source) * CELLS];
+      bool done[CELLS] = {false};
+      dist[source] = 0;
+      while (true) {
+        int here = -1;
+        for (int cell = 0; cell < CELLS; ++ cell)
+          if (!done[cell] && dist[cell] != UNREACHABLE && (here < 0 || dist[cell] < dist[here]))
+            here = cell;
+        if (here < 0)
+          break;
+        done[here] = true;
+        const int hx = here % BLOCK_SIZE, hy = here / BLOCK_SIZE;
+        for (int dy = -1; dy <= 1; ++ dy) {
+          for (int dx = -1; dx <= 1; ++ dx) {
+            const int xx = hx + dx, yy = hy + dy;
+            if ((!dx && !dy) || xx < 0 || yy < 0 || xx >= BLOCK_SIZE || yy >= BLOCK_SIZE)
+              continue;
+            const int there = yy * BLOCK_SIZE + xx;
+            if (!(pattern & (1 << there)))
+              continue;
+            // Diagonal moves need both adjacent cardinal cells open unless cutting corners
+            if (dx && dy && !corner_cut &&
+                (!(pattern & (1 << (hy * BLOCK_SIZE + xx))) ||
+                 !(pattern & (1 << (yy * BLOCK_SIZE + hx)))))
+              continue;
+            const int d = dist[here] + (dx && dy ? diagonal_cost : cardinal_cost);
+            assert(d < UNREACHABLE);
+            if (d < dist[there])
+              dist[there] = d;
+          }
+        }
+      }
+    }
+  }
+}
+
+bool LocalDistanceDatabase::load(string filename) {
+  ifstream file(filename.c_str(), ios::in | ios::binary);
+  if (!file.good())
+    return false;
+  char magic[4];
+  int settings[4];
+  file.read(magic, sizeof(magic));
+  file.read((char*) settings, sizeof(settings));
+  if (!file.good() || memcmp(magic, LDDB_MAGIC, sizeof(magic)) ||
+      settings[0] != BLOCK_SIZE || settings[1] != cardinal_cost ||
+      settings[2] != diagonal_cost || settings[3] != corner_cut)
+    return false;
+  distances.resize((size_t) (1 << CELLS) * CELLS * CELLS);
+  file.read((char*) distances.data(), distances.size() * sizeof(uint16_t));
+  if (!file.good()) {
+    distances.clear();
+    return false;
+  }
+  loaded_from_disk = true;
+  return true;
+}
+
+void LocalDistanceDatabase::save(string filename) {
+  ofstream file(filename.c_str(), ios::out | ios::binary | ios::trunc);
+  const int settings[4] = {BLOCK_SIZE, cardinal_cost, diagonal_cost, corner_cut};
+  file.write(LDDB_MAGIC, sizeof(LDDB_MAGIC));
+  file.write((const char*) settings, sizeof(settings));
+  file.write((const char*) distances.data(), distances.size() * sizeof(uint16_t));
+}
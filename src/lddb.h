@@ -0,0 +1,49 @@
+#ifndef LDDB_H
+#define LDDB_H
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+/// A local distance database for Block A* (Yap, Burch, Holte, and Schaeffer '11).
+// For every pattern of open and blocked cells in a BLOCK_SIZE x BLOCK_SIZE
+// block, this holds the cost of the cheapest path between every pair of cells
+// that stays inside the block.  Cells are numbered row-major within the block,
+// and a pattern sets bit i when cell i is open.
+//
+// The table only depends on the move costs and the corner-cutting rule, so
+// it's built once, saved to disk, and shared by every map with those settings.
+class LocalDistanceDatabase {
+ public:
+  static const int BLOCK_SIZE = 4;
+  static const int CELLS = BLOCK_SIZE * BLOCK_SIZE;
+  static const uint16_t UNREACHABLE = UINT16_MAX;
+
+  LocalDistanceDatabase() {
+    cardinal_cost = diagonal_cost = 0;
+    corner_cut = loaded_from_disk = false;
+  }
+
+  /// The database for these settings: from memory if we've seen them, else
+  /// from a file in `directory', else built from scratch and saved there.
+  /// Safe to call from several threads; only one of them builds a database.
+  static LocalDistanceDatabase & cached(int cardinal_cost, int diagonal_cost,
+                                        bool corner_cut, string directory);
+
+  void build(int cardinal_cost, int diagonal_cost, bool corner_cut);
+  bool load(string filename);
+  void save(string filename);
+  string filename(string directory);
+
+  inline uint16_t distance(uint32_t pattern, int from, int to) {
+    return distances[(pattern * CELLS + from) * CELLS + to];
+  }
+
+  int cardinal_cost, diagonal_cost;
+  bool corner_cut;
+  bool loaded_from_disk;         // as opposed to built by this process
+  char reserved[6];
+  vector<uint16_t> distances;
+};
+
+#endif // LDDB_H
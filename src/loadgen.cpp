@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+using namespace std;
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "graph.h"
+#include "protocol.h"
+
+/// Load generator for the path-query server.
+// Samples random start/goal pairs from a local copy of the map, then drives
+// the server from several connections, each keeping a fixed number of
+// requests in flight.  Reports client-observed throughput and latency, then
+// asks the server for its own counters.  With -d, every so often a request
+// toggles a "door" cell closed and then open again.  Doors are drawn from a
+// small pool of cells that no query starts or ends on, so a closed door can
+// cut a query off from its goal (answered with NO_PATH, which is counted on
+// its own) but never invalidates its endpoints.
+
+typedef chrono::steady_clock Clock;
+
+const int RANDOM_SEED = 10;
+const size_t NUM_DOORS = 16;
+
+struct Client {
+  vector<protocol::Request> requests;
+  vector<double> latencies_us;
+  size_t failures;              // answers other than OK and NO_PATH
+  size_t no_paths;
+  Client() { failures = no_paths = 0; }
+};
+
+int connect_to(const char * socket_path) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (sockaddr*) &address, sizeof(address)) < 0) {
+    perror(socket_path);
+    exit(1);
+  }
+  return fd;
+}
+
+bool read_all(int fd, void * data, size_t size) {
+  char * out = (char*) data;
+  while (size > 0) {
+    ssize_t got = read(fd, out, size);
+    if (got <= 0)
+      return false;
+    out += got;
+    size -= got;
+  }
+  return true;
+}
+
+void run_client(const char * socket_path, Client & client, size_t window) {
+  int fd = connect_to(socket_path);
+  vector<Clock::time_point> sent_at(client.requests.size());
+  size_t sent = 0, received = 0;
+  while (received < client.requests.size()) {
+    // Top up the window, sending everything in one write
+    const size_t first = sent;
+    while (sent < client.requests.size() && sent - received < window)
+      sent_at[sent++] = Clock::now();
+    if (sent > first) {
+      const size_t bytes = (sent - first) * sizeof(protocol::Request);
+      if (write(fd, &client.requests[first], bytes) != (ssize_t) bytes) {
+        perror("write");
+        exit(1);
+      }
+    }
+    protocol::Response response;
+    if (!read_all(fd, &response, sizeof(response))) {
+      cerr << "Server hung up" << endl;
+      exit(1);
+    }
+    client.latencies_us.push_back(chrono::duration<double, micro>(
+      Clock::now() - sent_at[response.id]).count());
+    if (response.status == protocol::STATUS_NO_PATH)
+      ++ client.no_paths;
+    else if (response.status != protocol::STATUS_OK)
+      ++ client.failures;
+    ++ received;
+  }
+  close(fd);
+}
+
+void print_server_counters(const char * socket_path) {
+  protocol::Request request;
+  memset(&request, 0, sizeof(request));
+  request.opcode = protocol::OP_STATS;
+  int fd = connect_to(socket_path);
+  protocol::Response response;
+  protocol::Counters counters;
+  if (write(fd, &request, sizeof(request)) != sizeof(request) ||
+      !read_all(fd, &response, sizeof(response)) ||
+      !read_all(fd, &counters, sizeof(counters))) {
+    cerr << "Couldn't fetch server counters" << endl;
+    exit(1);
+  }
+  close(fd);
+  cout << "Server counters:" << endl;
+  cout << " Workers: " << counters.workers << endl;
+  cout << " Requests: " << counters.requests << endl;
+  cout << " Failures: " << counters.failures << endl;
+  cout << " Batches: " << counters.batches << endl;
+  if (counters.requests) {
+    cout << " Mean batch size: " << counters.requests / (double) counters.batches << endl;
+    cout << " Mean latency (us): " << counters.total_latency_us / (double) counters.requests << endl;
+  }
+  cout << " Max latency (us): " << counters.max_latency_us << endl;
+  cout << " Uptime (sec): " << counters.uptime_us / 1e6 << endl;
+}
+
+void usage(const char * program) {
+  cerr << "Usage: " << program << " [-n requests] [-c connections] [-w window]"
+       << " [-a algorithm] [-m map_index] [-d door_every] socket map" << endl;
+  exit(1);
+}
+
+int main(int argc, char ** argv) {
+  size_t num_requests = 100000, num_connections = 4, window = 32;
+  size_t door_every = 0;
+  int algorithm = protocol::ALG_ASTAR_HEAP, map_index = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:c:w:a:m:d:")) != -1) {
+    switch (opt) {
+    case 'n': num_requests = atoi(optarg); break;
+    case 'c': num_connections = atoi(optarg); break;
+    case 'w': window = atoi(optarg); break;
+    case 'a': algorithm = atoi(optarg); break;
+    case 'm': map_index = atoi(optarg); break;
+    case 'd': door_every = atoi(optarg); break;
+    default: usage(argv[0]);
+    }
+  }
+  if (argc - optind != 2 || num_connections < 1 || window < 1)
+    usage(argv[0]);
+  const char * socket_path = argv[optind];
+
+  Graph graph;
+  graph.load_ascii_map(argv[optind + 1]);
+  srand(RANDOM_SEED);
+  vector<Node*> doors;
+  vector<bool> is_door(graph.width * graph.height, false);
+  while (door_every && doors.size() < min(NUM_DOORS, graph.size() / 2)) {
+    Node * node = graph.random_node();
+    if (!is_door[node->grid_y * graph.width + node->grid_x]) {
+      is_door[node->grid_y * graph.width + node->grid_x] = true;
+      doors.push_back(node);
+    }
+  }
+  vector<Client> clients(num_connections);
+  size_t toggles = 0;
+  for (size_t ii = 0; ii < num_requests; ++ ii) {
+    // Doors toggle on the first connection, so they close and open in order
+    const bool toggle = door_every && ii % door_every == door_every - 1;
+    Client & client = clients[toggle ? 0 : ii % num_connections];
+    Node *ss = 0, *gg = 0;
+    while (ss == gg || is_door[ss->grid_y * graph.width + ss->grid_x] ||
+           is_door[gg->grid_y * graph.width + gg->grid_x]) {
+      ss = graph.random_node();
+      gg = graph.random_node();
+    }
+    protocol::Request request;
+    memset(&request, 0, sizeof(request));
+    request.id = client.requests.size();
+    request.opcode = protocol::OP_PATH;
+    request.algorithm = algorithm;
+    request.map_index = map_index;
+    request.start_x = ss->grid_x;
+    request.start_y = ss->grid_y;
+    request.goal_x = gg->grid_x;
+    request.goal_y = gg->grid_y;
+    if (toggle) {
+      // Close the next door, or reopen the last one with its own weight
+      Node * door = doors[toggles / 2 % doors.size()];
+      request.opcode = toggles % 2 ? protocol::OP_SET_OPEN : protocol::OP_SET_BLOCKED;
+      request.start_x = door->grid_x;
+      request.start_y = door->grid_y;
+      request.goal_x = graph.cell_weights[door->grid_y * graph.width + door->grid_x];
+      ++ toggles;
+    }
+    client.requests.push_back(request);
+  }
+
+  Clock::time_point started = Clock::now();
+  vector<thread> threads;
+  for (auto& client: clients)
+    threads.push_back(thread(run_client, socket_path, ref(client), window));
+  for (auto& th: threads)
+    th.join();
+  const double seconds = chrono::duration<double>(Clock::now() - started).count();
+
+  vector<double> latencies;
+  size_t failures = 0, no_paths = 0;
+  for (auto& client: clients) {
+    latencies.insert(latencies.end(), client.latencies_us.begin(), client.latencies_us.end());
+    failures += client.failures;
+    no_paths += client.no_paths;
+  }
+  sort(latencies.begin(), latencies.end());
+  cout << "Load generator:" << endl;
+  cout << " Total requests: " << latencies.size() << endl;
+  cout << " Failures: " << failures << endl;
+  cout << " No path: " << no_paths << endl;
+  cout << " Throughput (req/sec): " << latencies.size() / seconds << endl;
+  if (!latencies.empty()) {
+    cout << " Median latency (us): " << latencies[latencies.size() / 2] << endl;
+    cout << " 99th percentile latency (us): " << latencies[latencies.size() * 99 / 100] << endl;
+  }
+  cout << " Total time (sec): " << seconds << endl;
+  print_server_counters(socket_path);
+  return 0;
+}
@@ -1,10 +1,70 @@
 #include <string.h>
+#include <thread>
 #include "benchmarks.h"
 #include "test.h"
 
 int main(int argc, char ** argv) {
   if (argc > 1 && strcmp(argv[1], "--test") == 0) {
-    return test_path_costs();
+    return test_path_costs() || test_terrain_costs() || test_map_edits() ||
+      test_tiled_grid() || test_hda_star() || test_reorder() || test_block_astar() ||
+      test_line_of_sight() || test_workload() || test_profile() ||
+      test_canonical_dijkstra() || test_server();
+  }
+  if (argc > 1 && strcmp(argv[1], "--tiled") == 0) {
+    string map_filename = argc > 2 ? argv[2] : "../maps/example.map";
+    uint32_t tile_size = argc > 3 ? atoi(argv[3]) : 16;
+    size_t max_resident = argc > 4 ? atoi(argv[4]) : 4;
+    benchmark_tiled_grid(map_filename, tile_size, max_resident);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--hda") == 0) {
+    int dim = argc > 2 ? atoi(argv[2]) : 1024;
+    size_t max_threads = argc > 3 ? atoi(argv[3]) : thread::hardware_concurrency();
+    benchmark_hda_star(dim, max_threads ? max_threads : 1);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--orders") == 0) {
+    benchmark_node_orders("../maps/example.map");
+    benchmark_node_orders("");
+    for (int ii = 2; ii < argc; ++ ii)
+      benchmark_node_orders(argv[ii]);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--block") == 0) {
+    benchmark_block_astar(argc > 2 ? argv[2] : "../maps/example.map");
+    benchmark_block_astar("");
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--los") == 0) {
+    benchmark_line_of_sight(argc > 2 ? argv[2] : "../maps/example.map");
+    benchmark_line_of_sight("");
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--sweeps") == 0) {
+    size_t max_threads = argc > 2 ? atoi(argv[2]) : thread::hardware_concurrency();
+    if (!max_threads)
+      max_threads = 1;
+    benchmark_canonical_dijkstra("../maps/example.map", max_threads);
+    benchmark_canonical_dijkstra("../maps/random-256.map", max_threads);
+    for (int ii = 3; ii < argc; ++ ii)
+      benchmark_canonical_dijkstra(argv[ii], max_threads);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--profile") == 0) {
+    string map_filename = argc > 2 ? argv[2] : "../maps/random-256.map";
+    size_t num_threads = argc > 3 ? atoi(argv[3]) : 2;
+    string folded_filename = argc > 4 ? argv[4] : "search.folded";
+    benchmark_profile(map_filename, num_threads, folded_filename);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+    string baseline_filename = argc > 2 ? argv[2] : "bench_baseline.txt";
+    double threshold = argc > 3 ? atof(argv[3]) : 0.2;
+    return benchmark_workloads(baseline_filename, threshold, false);
+  }
+  if (argc > 1 && strcmp(argv[1], "--bench-baseline") == 0) {
+    string baseline_filename = argc > 2 ? argv[2] : "bench_baseline.txt";
+    return benchmark_workloads(baseline_filename, 0, true);
   }
   benchmark_grid_costs();
   return 0;
@@ -1,36 +1,64 @@
+#ifndef NODE_HEAP_H
+#define NODE_HEAP_H
 #include <vector>
 using namespace std;
 
+#include "graph.h"
+
 /// Implementation of a binary heap implemented on top of a vector.
+// The nodes' f and g costs and heap positions are read through `state' (see
+// search.h), wherever the search keeps them.
 namespace node_heap {
+  /// An entry for the searches that keep their open list in a priority_queue
+  /// rather than this heap, with the f and g it was pushed with.
+  template <class T>
+  struct Entry {
+    int f, g;
+    T payload;                        // the node or state
+    // priority_queue puts the largest first, so invert: tiebreak on larger g
+    bool operator<(const Entry & other) const {
+      return f > other.f || (f == other.f && g < other.g);
+    }
+  };
+
   /// In A*, one node is 'better' than the other when it has a lower f cost.
-  bool better(Node* n1, Node* n2) {
+  template <class State>
+  inline bool better(State & state, Node* n1, Node* n2) {
     // tiebreak on larger g
-    return (n1->f < n2->f) || (n1->f == n2->f && n1->g > n2->g);
+    return (state.f(n1) < state.f(n2)) ||
+      (state.f(n1) == state.f(n2) && state.g(n1) > state.g(n2));
   }
 
-  void repair(vector<Node*> & open_list, int ii) {
+  template <class State>
+  inline void swap_entries(State & state, vector<Node*> & open_list, int ii, int jj) {
+    swap(open_list[ii], open_list[jj]);
+    swap(state.heap_index(open_list[ii]), state.heap_index(open_list[jj]));
+  }
+
+  template <class State>
+  void repair(State & state, vector<Node*> & open_list, int ii) {
     while (true) {
       int parent = (ii + 1) / 2 - 1;
       if (parent < 0)
         break;
-      if (!better(open_list[ii], open_list[parent]))
+      if (!better(state, open_list[ii], open_list[parent]))
         break;
-      swap(open_list[ii], open_list[parent]);
-      swap(open_list[ii]->heap_index, open_list[parent]->heap_index);
+      swap_entries(state, open_list, ii, parent);
       ii = parent;
     }
   }
 
-  void push(vector<Node*> & open_list, Node* add_me) {
+  template <class State>
+  void push(State & state, vector<Node*> & open_list, Node* add_me) {
     open_list.push_back(add_me);
-    add_me->heap_index = open_list.size() - 1;
-    repair(open_list, add_me->heap_index);
+    state.heap_index(add_me) = open_list.size() - 1;
+    repair(state, open_list, state.heap_index(add_me));
   }
 
-  void pop(vector<Node*> & open_list) {
+  template <class State>
+  void pop(State & state, vector<Node*> & open_list) {
     open_list.front() = open_list.back();
-    open_list.front()->heap_index = 0;
+    state.heap_index(open_list.front()) = 0;
     open_list.pop_back();
 
     for (size_t ii = 0;;) {
@@ -41,22 +69,22 @@ namespace node_heap {
         return;
       if (son2 >= (int) open_list.size())
         son2 = son1;
-      if (better(open_list[ii], open_list[son1]) &&
-          better(open_list[ii], open_list[son2]))
+      if (better(state, open_list[ii], open_list[son1]) &&
+          better(state, open_list[ii], open_list[son2]))
         return;
 
-      if (!better(open_list[ii], open_list[son1]) &&
-          better(open_list[son1], open_list[son2])) {
-        swap(open_list[ii], open_list[son1]);
-        swap(open_list[ii]->heap_index, open_list[son1]->heap_index);
+      if (!better(state, open_list[ii], open_list[son1]) &&
+          better(state, open_list[son1], open_list[son2])) {
+        swap_entries(state, open_list, ii, son1);
         ii = son1;
         continue;
       }
       else {
-        swap(open_list[ii], open_list[son2]);
-        swap(open_list[ii]->heap_index, open_list[son2]->heap_index);
+        swap_entries(state, open_list, ii, son2);
         ii = son2;
       }
     }
   }
 }
+
+#endif // NODE_HEAP_H
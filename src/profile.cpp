@@ -0,0 +1,88 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+using namespace std;
+#include <cassert>
+#include "profile.h"
+
+// Every thread's profile, in order of creation.  Profiles outlive their
+// threads, so they can be read after the threads are joined.
+static mutex profiles_mutex;
+static vector<PhaseProfile*> profiles;
+
+PhaseProfile::PhaseProfile(unsigned int thread_number) {
+  this->thread_number = thread_number;
+  current = 0;
+  Phase root = {"", 0, 0, -1, -1, -1, 0};
+  phases.push_back(root);
+}
+
+PhaseProfile & PhaseProfile::local() {
+  static thread_local PhaseProfile * profile = 0;
+  if (!profile) {
+    lock_guard<mutex> lock(profiles_mutex);
+    profile = new PhaseProfile(profiles.size());
+    profiles.push_back(profile);
+  }
+  return *profile;
+}
+
+int PhaseProfile::add_phase(const char * name) {
+  Phase phase = {name, 0, 0, current, -1, phases[current].first_child, 0};
+  phases.push_back(phase);
+  phases[current].first_child = phases.size() - 1;
+  return phases.size() - 1;
+}
+
+/// Ticks spent in each stack of phases, not counting nested phases, keyed by
+/// the folded stack.  With `per_thread', stacks start with the thread.
+static map<string, uint64_t> fold_stacks(bool per_thread) {
+  lock_guard<mutex> lock(profiles_mutex);
+  map<string, uint64_t> stacks;
+  for (auto& profile: profiles) {
+    const vector<PhaseProfile::Phase> & phases = profile->phases;
+    for (size_t ii = 1; ii < phases.size(); ++ ii) {
+      uint64_t self = phases[ii].ticks;
+      for (int child = phases[ii].first_child; child >= 0; child = phases[child].next_sibling)
+        self -= phases[child].ticks;
+      string stack = phases[ii].name;
+      for (int parent = phases[ii].parent; parent > 0; parent = phases[parent].parent)
+        stack = string(phases[parent].name) + ";" + stack;
+      if (per_thread)
+        stack = "thread-" + to_string(profile->thread_number) + ";" + stack;
+      stacks[stack] += self;
+    }
+  }
+  return stacks;
+}
+
+void PhaseProfile::write_folded(string filename) {
+  ofstream file(filename.c_str(), ios::out | ios::trunc);
+  for (auto& stack: fold_stacks(true))
+    file << stack.first << " " << stack.second << endl;
+  assert(file.good());
+}
+
+void PhaseProfile::print_summary() {
+  const map<string, uint64_t> stacks = fold_stacks(false);
+  map<string, uint64_t> totals;       // by outermost phase
+  const streamsize precision = cout.precision();
+  for (auto& stack: stacks)
+    totals[stack.first.substr(0, stack.first.find(';'))] += stack.second;
+  for (auto& stack: stacks) {
+    const uint64_t total = totals[stack.first.substr(0, stack.first.find(';'))];
+    cout << " " << setw(6) << fixed << setprecision(2)
+         << 100.0 * stack.second / max(total, (uint64_t) 1) << "%  " << stack.first << endl;
+  }
+  cout.unsetf(ios::fixed);
+  cout.precision(precision);
+}
+
+void PhaseProfile::reset() {
+  lock_guard<mutex> lock(profiles_mutex);
+  for (auto& profile: profiles)
+    for (auto& phase: profile->phases)
+      phase.ticks = phase.calls = 0;
+}
@@ -0,0 +1,104 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/// Timing of the phases of a search, broken down per thread.
+// Wrap a phase in PROFILE_SCOPE("name") and the time spent in it is charged to
+// the current stack of phases (say "astar_heap;neighbors;heuristic").  Each
+// thread keeps its own tree of phases, so timing never contends; the trees are
+// only read by PhaseProfile::write_folded, which should run once the
+// searching threads are done.  Unless the build defines PROFILE_SEARCH, the
+// scopes compile to nothing (see `make profile').
+
+/// Timestamp counter ticks on x86, nanoseconds elsewhere.
+inline uint64_t profile_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return chrono::duration_cast<chrono::nanoseconds>(
+    chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class PhaseProfile {
+ public:
+  struct Phase {
+    const char * name;
+    uint64_t ticks;                   // including nested phases
+    uint64_t calls;
+    int parent, first_child, next_sibling;
+    int reserved;
+  };
+
+  /// This thread's profile, created on first use.
+  static PhaseProfile & local();
+
+  /// Write every thread's phases as folded stacks (one "stack ticks" line per
+  /// stack, ticks excluding nested phases), ready for flamegraph.pl.  Each
+  /// stack starts with the thread's number.
+  static void write_folded(string filename);
+
+  /// Print each stack's share of the time in its outermost phase (the search
+  /// algorithm), summed over threads.
+  static void print_summary();
+
+  /// Zero every thread's profile.
+  static void reset();
+
+  /// Start timing `name' within the current phase; returns the current phase,
+  /// to hand back to leave().
+  inline int enter(const char * name) {
+    const int previous = current;
+    int child = phases[current].first_child;
+    while (child >= 0 && phases[child].name != name)
+      child = phases[child].next_sibling;
+    current = child >= 0 ? child : add_phase(name);
+    return previous;
+  }
+
+  inline void leave(int previous, uint64_t ticks) {
+    phases[current].ticks += ticks;
+    ++ phases[current].calls;
+    current = previous;
+  }
+
+  vector<Phase> phases;               // phases[0] is the thread itself
+  int current;
+  unsigned int thread_number;
+
+ private:
+  PhaseProfile(unsigned int thread_number);
+  int add_phase(const char * name);
+};
+
+class ScopedPhase {
+ public:
+  ScopedPhase(const char * name) : profile(PhaseProfile::local()) {
+    previous = profile.enter(name);
+    started = profile_ticks();
+  }
+  ~ScopedPhase() { profile.leave(previous, profile_ticks() - started); }
+
+ private:
+  PhaseProfile & profile;
+  uint64_t started;
+  int previous;
+  int reserved;
+};
+
+#ifdef PROFILE_SEARCH
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ScopedPhase PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+#endif // PROFILE_H
@@ -0,0 +1,80 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+#include <string>
+#include <vector>
+using namespace std;
+#include <cstdint>
+#include <cstring>
+
+/// Wire format shared by the path-query server and its load generator.
+// Every message is a fixed-size struct written back to back on a SOCK_STREAM
+// Unix socket.  Both ends live on the same machine, so fields are sent in host
+// byte order.  The server answers in completion order rather than arrival
+// order; clients match responses to requests using `id'.
+//
+// Map edits sent back to back in one write are applied together.  A request
+// is answered against the maps as they stood when the server read it: with
+// every edit sent before it on its connection, and none sent after it, even
+// though the answers may arrive out of order.  Edits from other connections
+// are seen if the server read them first.
+namespace protocol {
+  enum Opcode { OP_PATH = 1, OP_STATS = 2, OP_SET_BLOCKED = 3, OP_SET_OPEN = 4 };
+  enum Algorithm { ALG_ASTAR_HEAP = 0, ALG_FRINGE_SEARCH = 1, ALG_ASTAR_BASIC = 2 };
+  enum Status {
+    STATUS_OK = 0,
+    STATUS_NO_PATH = 1,         // start and goal are disconnected
+    STATUS_BAD_MAP = 2,         // map_index is out of range
+    STATUS_BAD_NODE = 3,        // start or goal is off the map or blocked
+    STATUS_BAD_REQUEST = 4      // unknown opcode or algorithm, or weight over MAX_WEIGHT
+  };
+
+  struct Request {
+    uint32_t id;                // echoed back in the response
+    uint8_t opcode;             // an Opcode
+    uint8_t algorithm;          // an Algorithm (OP_PATH only)
+    uint16_t map_index;         // position of the map on the server's command line
+    uint32_t start_x, start_y;  // the edited cell, for OP_SET_*
+    uint32_t goal_x, goal_y;    // goal_x is the terrain weight for OP_SET_OPEN (0 means 1)
+  };
+
+  struct Response {
+    uint32_t id;
+    uint8_t opcode;
+    uint8_t status;             // a Status
+    uint16_t reserved;
+    uint32_t path_cost;
+    uint32_t path_length;
+    uint32_t nodes_expanded;
+    uint32_t latency_us;        // receipt to completion, measured by the server
+    uint32_t version;           // map edits (batches of OP_SET_*) seen by the answer
+  };
+
+  /// Follows a Response whose opcode is OP_STATS.
+  struct Counters {
+    uint64_t requests;          // path queries answered (including failures)
+    uint64_t failures;          // path queries answered with status != OK
+    uint64_t batches;           // batches handed to the worker pool
+    uint64_t total_latency_us;  // summed over all path queries
+    uint64_t max_latency_us;
+    uint64_t uptime_us;
+    uint32_t workers;
+    uint32_t maps;
+  };
+
+  /// Append a message to a buffer of outgoing bytes.
+  template <class Message>
+  inline void encode(const Message & message, string & out) {
+    out.append((const char*) &message, sizeof(message));
+  }
+
+  /// Decode the whole messages at the front of `size' bytes into `out', and
+  /// return how many bytes they took up.
+  template <class Message>
+  inline size_t decode(const char * data, size_t size, vector<Message> & out) {
+    out.resize(size / sizeof(Message));
+    memcpy(out.data(), data, out.size() * sizeof(Message));
+    return out.size() * sizeof(Message);
+  }
+}
+
+#endif // PROTOCOL_H
@@ -0,0 +1,271 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+#include <list>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#include <climits>
+#include "algorithms.h"
+#include "graph.h"
+#include "node_heap.h"
+#include "profile.h"
+#include "stats.h"
+
+/// The optimal searches, written once over where they keep each node's state.
+// NodeState (algorithms.cpp) keeps it in the Nodes themselves, for graphs that
+// one thread searches at a time; SearchSpace (service.h) keeps it in arrays of
+// its own, so that several threads can search one graph.  A State provides:
+//
+//   void begin(Graph&, Stats&)        start a new problem
+//   bool closed(Node*)                closed on this problem?
+//   void close(Node*)                 close it, and take it off the open list
+//   bool is_open(Node*), void set_open(Node*, bool)
+//   int g(Node*), int f(Node*)
+//   Node* whence(Node*), void set_whence(Node*, Node*)
+//   void relax(Node*, int g, int h, Node* whence)
+//   int & heap_index(Node*)
+//   list<Node*>::iterator & fringe_index(Node*)
+//
+// Every search leaves no node open when it returns.  The open lists are
+// thread-local, like the state of a NodeState.
+namespace search {
+  /// h(graph, node, goal), timed as a phase of its own when profiling.
+  inline unsigned int estimate(unsigned int (*h)(Graph&, Node*, Node*), Graph & graph,
+                               Node* node, Node* goal) {
+    PROFILE_SCOPE("heuristic");
+    return h(graph, node, goal);
+  }
+
+  template <class State>
+  void reconstruct_path(Graph & graph, Node* start, Node* current, Stats & stats,
+                        State & state) {
+    PROFILE_SCOPE("reconstruct_path");
+    while (current != start) {
+      Node* previous = state.whence(current);
+      stats.path_cost += graph.cost(previous, current);
+      ++ stats.path_length;
+      current = previous;
+    }
+  }
+
+  /// See direct_path in algorithms.h.
+  template <class State>
+  bool direct_path(Graph & graph, Node* start, Node* goal, State & state) {
+    static thread_local vector<pair<int, int> > cells;
+    if (!direct_line(graph, start, goal, cells))
+      return false;
+    Node* previous = start;
+    for (size_t ii = 1; ii < cells.size(); ++ ii) {
+      Node* here = graph.node_at(cells[ii].first, cells[ii].second);
+      state.set_whence(here, previous);
+      previous = here;
+    }
+    return true;
+  }
+
+  template <class State>
+  bool astar_basic(Graph & graph, Node* start, Node* goal, Stats & stats,
+                   unsigned int (*h)(Graph&, Node*, Node*), State & state) {
+    PROFILE_SCOPE("astar_basic");
+    state.begin(graph, stats);
+    static thread_local vector<Node*> open_list;
+    state.set_open(start, true);
+    state.relax(start, 0, estimate(h, graph, start, goal), NULL);
+    open_list.push_back(start);
+
+    while (!open_list.empty()) {
+      Node* expand_me;
+      {
+        PROFILE_SCOPE("open_list");
+        int fmin = INT_MAX;
+        auto best_on_open_list = open_list.begin();
+        // Pop the best node off the open_list via linear scan
+        for (auto node = open_list.begin(); node != open_list.end(); ++ node) {
+          if (state.f(*node) < fmin) {
+            fmin = state.f(*node);
+            best_on_open_list = node;
+          }
+        }
+        expand_me = *best_on_open_list;
+        if (expand_me == goal)
+          break;
+        // remove it by overwriting it with the back() node
+        *best_on_open_list = open_list.back();
+        open_list.pop_back();
+      }
+      state.close(expand_me);
+      ++ stats.nodes_expanded;
+
+      // Add each neighbor
+      PROFILE_SCOPE("neighbors");
+      for (size_t ii = 0; ii < expand_me->neighbors_out.size(); ++ ii) {
+        Node* add_me = expand_me->neighbors_out[ii];
+        if (state.closed(add_me))
+          continue;
+        const int g = state.g(expand_me) + expand_me->costs_out[ii];
+        if (!state.is_open(add_me)) {       // If it's not open, open it
+          state.set_open(add_me, true);
+          state.relax(add_me, g, estimate(h, graph, add_me, goal), expand_me);
+          open_list.push_back(add_me);
+        }
+        else if (state.g(add_me) > g) {     // If it is open, relax it
+          state.relax(add_me, g, estimate(h, graph, add_me, goal), expand_me);
+        }
+      }
+    }
+
+    // Stats collection & cleanup
+    const bool found = !open_list.empty();
+    stats.open_list_size += open_list.size();
+    if (found)
+      reconstruct_path(graph, start, goal, stats, state);
+    for (auto node: open_list)
+      state.set_open(node, false);
+    open_list.clear();
+    return found;
+  }
+
+  template <class State>
+  bool astar_heap(Graph & graph, Node* start, Node* goal, Stats & stats,
+                  unsigned int (*h)(Graph&, Node*, Node*), State & state) {
+    PROFILE_SCOPE("astar_heap");
+    state.begin(graph, stats);
+    bool direct;
+    {
+      PROFILE_SCOPE("direct_path");
+      direct = direct_path(graph, start, goal, state);
+    }
+    if (direct) {
+      ++ stats.direct_paths;
+      reconstruct_path(graph, start, goal, stats, state);
+      return true;
+    }
+    static thread_local vector<Node*> open_list;
+    state.set_open(start, true);
+    state.relax(start, 0, estimate(h, graph, start, goal), NULL);
+    node_heap::push(state, open_list, start);
+
+    while (!open_list.empty()) {
+      // Pop the best node off the open_list (+ goal check)
+      Node* expand_me = open_list.front();
+      if (expand_me == goal)
+        break;
+
+      ++ stats.nodes_expanded;
+      state.close(expand_me);
+      {
+        PROFILE_SCOPE("open_list");
+        node_heap::pop(state, open_list);
+      }
+
+      // Add each neighbor
+      PROFILE_SCOPE("neighbors");
+      for (size_t ii = 0; ii < expand_me->neighbors_out.size(); ++ ii) {
+        Node* add_me = expand_me->neighbors_out[ii];
+        if (state.closed(add_me))
+          continue;
+        const int g = state.g(expand_me) + expand_me->costs_out[ii];
+        if (!state.is_open(add_me)) {       // If it's not open, open it
+          state.set_open(add_me, true);
+          state.relax(add_me, g, estimate(h, graph, add_me, goal), expand_me);
+          PROFILE_SCOPE("open_list");
+          node_heap::push(state, open_list, add_me);
+        }
+        else if (g < state.g(add_me)) {     // If it is open, relax it
+          state.relax(add_me, g, state.f(add_me) - state.g(add_me), expand_me);
+          PROFILE_SCOPE("open_list");
+          node_heap::repair(state, open_list, state.heap_index(add_me));
+        }
+      }
+    }
+
+    // Stats collection & cleanup
+    const bool found = !open_list.empty();
+    stats.open_list_size += open_list.size();
+    if (found)
+      reconstruct_path(graph, start, goal, stats, state);
+    for (auto& node: open_list)
+      state.set_open(node, false);
+    open_list.clear();
+    return found;
+  }
+
+  template <class State>
+  bool fringe_search(Graph & graph, Node* start, Node* goal, Stats & stats,
+                     unsigned int (*h)(Graph&, Node*, Node*), State & state) {
+    PROFILE_SCOPE("fringe_search");
+    state.begin(graph, stats);
+    static thread_local list<Node*> Fringe;
+    Fringe.push_back(start);
+    state.set_open(start, true);
+    state.relax(start, 0, estimate(h, graph, start, goal), NULL);
+    state.fringe_index(start) = Fringe.begin();
+    bool found = false;
+    int f_limit = state.f(start);
+
+    while (!found && !Fringe.empty()) {
+      int next_f_limit = INT_MAX;
+      for (auto ff = Fringe.begin(); ff != Fringe.end();) {
+        Node* expand_me = *ff;
+        // is this node outside the current depth?
+        if (state.f(expand_me) > f_limit) {
+          if (state.f(expand_me) < next_f_limit)
+            next_f_limit = state.f(expand_me); // track smallest next depth
+          ++ ff;
+          continue; // skip this one (for now)
+        }
+        if (expand_me == goal) {
+          found = true;
+          break;
+        }
+
+        ++ stats.nodes_expanded;
+        state.close(expand_me);
+
+        // Relax the neighbors and put them on the fringe AFTER `expand_me'
+        {
+          PROFILE_SCOPE("neighbors");
+          for (size_t ii = 0; ii < expand_me->neighbors_out.size(); ++ ii) {
+            Node* add_me = expand_me->neighbors_out[ii];
+            if (state.closed(add_me))
+              continue;
+            const int g = state.g(expand_me) + expand_me->costs_out[ii];
+
+            if (!state.is_open(add_me)) {
+              state.set_open(add_me, true);
+              state.relax(add_me, g, estimate(h, graph, add_me, goal), expand_me);
+              PROFILE_SCOPE("open_list");
+              auto insertion_point = next(ff);
+              state.fringe_index(add_me) = Fringe.insert(insertion_point, add_me);
+            }
+            else if (g < state.g(add_me)) {
+              state.relax(add_me, g, state.f(add_me) - state.g(add_me), expand_me);
+              PROFILE_SCOPE("open_list");
+              auto insertion_point = next(ff);
+              if (insertion_point == Fringe.end() || *insertion_point != add_me) {
+                Fringe.erase(state.fringe_index(add_me));
+                state.fringe_index(add_me) = Fringe.insert(insertion_point, add_me);
+              }
+            }
+          }
+        }
+        PROFILE_SCOPE("open_list");
+        ff = Fringe.erase(ff);
+      }
+      // Increase the depth and scan the fringe again
+      f_limit = next_f_limit;
+    }
+
+    // Stats collection & cleanup
+    stats.open_list_size += Fringe.size();
+    if (found)
+      reconstruct_path(graph, start, goal, stats, state);
+    for (auto& node: Fringe)
+      state.set_open(node, false);
+    Fringe.clear();
+    return found;
+  }
+}
+
+#endif // SEARCH_H
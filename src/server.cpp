@@ -0,0 +1,313 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "graph.h"
+#include "protocol.h"
+#include "service.h"
+
+/// A local path-query service.  The maps are loaded once at startup and
+/// queried by any number of clients over a Unix socket (see protocol.h).
+//
+// Each connection has a reader thread that turns whatever a single read()
+// returns into one batch of requests.  Batches go onto a shared queue that's
+// drained by a pool of workers; a worker answers its whole batch and writes
+// the responses back with one send().
+//
+// The maps are published as immutable versions (MapVersion, in service.h)
+// shared by every worker.  The workers only read them, and each keeps its own
+// search state in a SearchSpace.
+//
+// A reader that receives map edits makes a new version with them and
+// publishes it.  Each request in a batch records the version that was current
+// when it was read, counting the edits read before it, so it sees every edit
+// sent before it on its connection and none sent after, even when another
+// worker answers a later batch first.  Workers never wait for an edit, and an
+// edit never waits for a search.  The price is a copy of each edited map for
+// every run of edits.
+
+typedef chrono::steady_clock Clock;
+
+struct Connection {
+  mutex write_lock;             // workers answer batches concurrently
+  int fd;
+  int reserved;                 // explicit tail padding
+  Connection(int fd) { this->fd = fd; }
+  ~Connection() { close(fd); }
+};
+
+struct Batch {
+  shared_ptr<Connection> connection;
+  vector<protocol::Request> requests;
+  vector<shared_ptr<const MapVersion> > maps;   // the version each request is answered against
+  Clock::time_point received;
+};
+
+/// A blocking queue of batches shared by the readers and the workers.
+class BatchQueue {
+ public:
+  void push(Batch && batch) {
+    {
+      lock_guard<mutex> lock(this->lock);
+      batches.push_back(move(batch));
+    }
+    ready.notify_one();
+  }
+
+  Batch pop() {
+    unique_lock<mutex> lock(this->lock);
+    ready.wait(lock, [this] { return !batches.empty(); });
+    Batch batch = move(batches.front());
+    batches.pop_front();
+    return batch;
+  }
+
+ private:
+  mutex lock;
+  condition_variable ready;
+  deque<Batch> batches;
+};
+
+/// The latest published version of the maps.  Edits are serialized, so that
+/// each starts from the version the last one published.
+class CurrentMaps {
+ public:
+  shared_ptr<const MapVersion> get() {
+    lock_guard<mutex> lock(this->lock);
+    return current;
+  }
+
+  void set(shared_ptr<const MapVersion> maps) {
+    lock_guard<mutex> lock(this->lock);
+    current = maps;
+  }
+
+  /// Publish and return the version with `edits' applied to the current one.
+  shared_ptr<const MapVersion> edit(const vector<protocol::Request> & edits) {
+    lock_guard<mutex> lock(edit_lock);
+    shared_ptr<const MapVersion> next = edit_maps(*get(), edits);
+    set(next);
+    return next;
+  }
+
+ private:
+  mutex lock, edit_lock;
+  shared_ptr<const MapVersion> current;
+};
+
+/// Throughput and latency counters, updated without locks by the workers.
+struct Counters {
+  atomic<uint64_t> requests, failures, batches, total_latency_us, max_latency_us;
+  Clock::time_point started;
+
+  Counters() : requests(0), failures(0), batches(0), total_latency_us(0), max_latency_us(0) {
+    started = Clock::now();
+  }
+
+  void record(uint64_t latency_us, bool failed) {
+    ++ requests;
+    if (failed)
+      ++ failures;
+    total_latency_us += latency_us;
+    uint64_t max = max_latency_us.load();
+    while (latency_us > max && !max_latency_us.compare_exchange_weak(max, latency_us));
+  }
+};
+
+vector<string> map_files;
+CurrentMaps maps;
+BatchQueue queue;
+Counters counters;
+size_t num_workers = thread::hardware_concurrency() ? thread::hardware_concurrency() : 4;
+size_t max_batch = 64;
+const char * socket_path = 0;
+
+bool send_all(int fd, const char * data, size_t size) {
+  while (size > 0) {
+    ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+    if (sent <= 0)
+      return false;
+    data += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+void fill_counters(protocol::Counters & out) {
+  memset(&out, 0, sizeof(out));
+  out.requests = counters.requests;
+  out.failures = counters.failures;
+  out.batches = counters.batches;
+  out.total_latency_us = counters.total_latency_us;
+  out.max_latency_us = counters.max_latency_us;
+  out.uptime_us = chrono::duration_cast<chrono::microseconds>(
+    Clock::now() - counters.started).count();
+  out.workers = num_workers;
+  out.maps = map_files.size();
+}
+
+inline bool is_edit(const protocol::Request & request) {
+  return request.opcode == protocol::OP_SET_BLOCKED || request.opcode == protocol::OP_SET_OPEN;
+}
+
+void worker() {
+  SearchSpace space;
+  string out;
+  while (true) {
+    Batch batch = queue.pop();
+    ++ counters.batches;
+    out.clear();
+    for (size_t ii = 0; ii < batch.requests.size(); ++ ii) {
+      const protocol::Request & request = batch.requests[ii];
+      const MapVersion & version = *batch.maps[ii];
+      protocol::Response response;
+      memset(&response, 0, sizeof(response));
+      response.id = request.id;
+      response.opcode = request.opcode;
+      response.version = version.version;
+      if (request.opcode == protocol::OP_STATS) {
+        protocol::Counters snapshot;
+        fill_counters(snapshot);
+        protocol::encode(response, out);
+        protocol::encode(snapshot, out);
+        continue;
+      }
+      if (request.opcode == protocol::OP_PATH)
+        response.status = solve(version.graphs, space, request, response);
+      else if (is_edit(request))
+        response.status = check_edit(version.graphs, request);
+      else
+        response.status = protocol::STATUS_BAD_REQUEST;
+      const uint64_t latency_us = chrono::duration_cast<chrono::microseconds>(
+        Clock::now() - batch.received).count();
+      response.latency_us = latency_us;
+      counters.record(latency_us, response.status != protocol::STATUS_OK);
+      protocol::encode(response, out);
+    }
+    lock_guard<mutex> lock(batch.connection->write_lock);
+    send_all(batch.connection->fd, out.data(), out.size());
+  }
+}
+
+void reader(shared_ptr<Connection> connection) {
+  const size_t request_size = sizeof(protocol::Request);
+  vector<char> buffer(max_batch * request_size);
+  size_t filled = 0;
+  while (true) {
+    ssize_t got = read(connection->fd, buffer.data() + filled, buffer.size() - filled);
+    if (got <= 0)
+      return;
+    filled += got;
+    Batch batch;
+    const size_t used = protocol::decode(buffer.data(), filled, batch.requests);
+    if (!used)
+      continue;
+    batch.connection = connection;
+    batch.received = Clock::now();
+    // Each run of edits publishes one new version, which the edits and the
+    // requests after them are answered against
+    const vector<protocol::Request> & requests = batch.requests;
+    shared_ptr<const MapVersion> version = maps.get();
+    for (size_t ii = 0; ii < requests.size(); ++ ii) {
+      if (is_edit(requests[ii]) && (ii == 0 || !is_edit(requests[ii - 1]))) {
+        vector<protocol::Request> edits;
+        for (size_t jj = ii; jj < requests.size() && is_edit(requests[jj]); ++ jj)
+          edits.push_back(requests[jj]);
+        version = maps.edit(edits);
+      }
+      batch.maps.push_back(version);
+    }
+    queue.push(move(batch));
+    // Keep any partial request for the next read
+    filled -= used;
+    memmove(buffer.data(), buffer.data() + used, filled);
+  }
+}
+
+/// Load a map, or return false if it's missing or has no passable cells.
+bool load_map(const string & filename, Graph & graph) {
+  if (!ifstream(filename.c_str()).good())
+    return false;
+  graph.load_ascii_map(filename);
+  return graph.width && graph.height && graph.size();
+}
+
+void stop(int) {
+  unlink(socket_path);
+  _exit(0);
+}
+
+void usage(const char * program) {
+  cerr << "Usage: " << program << " [-j workers] [-b max_batch] socket map [map...]" << endl;
+  exit(1);
+}
+
+int main(int argc, char ** argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "j:b:")) != -1) {
+    if (opt == 'j')
+      num_workers = atoi(optarg);
+    else if (opt == 'b')
+      max_batch = atoi(optarg);
+    else
+      usage(argv[0]);
+  }
+  if (argc - optind < 2 || num_workers < 1 || max_batch < 1)
+    usage(argv[0]);
+  socket_path = argv[optind];
+  for (int ii = optind + 1; ii < argc; ++ ii)
+    map_files.push_back(argv[ii]);
+  // Load every map before taking the socket, so a bad one fails fast
+  shared_ptr<MapVersion> loaded = make_shared<MapVersion>();
+  loaded->version = 0;
+  for (auto& filename: map_files) {
+    loaded->owners.push_back(make_shared<Graph>());
+    loaded->graphs.push_back(loaded->owners.back().get());
+    if (!load_map(filename, *loaded->graphs.back())) {
+      cerr << "Couldn't load map: " << filename << endl;
+      return 1;
+    }
+  }
+  maps.set(loaded);
+
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    cerr << "Socket path too long: " << socket_path << endl;
+    return 1;
+  }
+  strcpy(address.sun_path, socket_path);
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path);
+  if (listener < 0 || bind(listener, (sockaddr*) &address, sizeof(address)) < 0 ||
+      listen(listener, 64) < 0) {
+    perror(socket_path);
+    return 1;
+  }
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  for (size_t ii = 0; ii < num_workers; ++ ii)
+    thread(worker).detach();
+  cout << "Serving " << map_files.size() << " map(s) on " << socket_path
+       << " with " << num_workers << " workers" << endl;
+
+  while (true) {
+    int fd = accept(listener, 0, 0);
+    if (fd < 0)
+      continue;
+    thread(reader, make_shared<Connection>(fd)).detach();
+  }
+}
@@ -0,0 +1,106 @@
+#include <memory>
+#include <vector>
+using namespace std;
+#include "heuristics.h"
+#include "search.h"
+#include "service.h"
+
+void SearchSpace::begin(Graph & graph, Stats & stats) {
+  ++ stats.num_problems;
+  // New entries are neither open nor closed
+  if (states.size() < graph.size())
+    states.resize(graph.size(), State());
+  ++ search;
+  // check integer overflow; search numbers are no longer unique, so reset.
+  if (search == 0) {
+    for (auto& state: states)
+      state.closed_id = 0;
+    search = 1;
+  }
+}
+
+bool SearchSpace::astar_heap(Graph & graph, Node* start, Node* goal, Stats & stats,
+                             unsigned int (*h)(Graph&, Node*, Node*)) {
+  return search::astar_heap(graph, start, goal, stats, h, *this);
+}
+
+bool SearchSpace::fringe_search(Graph & graph, Node* start, Node* goal, Stats & stats,
+                                unsigned int (*h)(Graph&, Node*, Node*)) {
+  return search::fringe_search(graph, start, goal, stats, h, *this);
+}
+
+bool SearchSpace::astar_basic(Graph & graph, Node* start, Node* goal, Stats & stats,
+                              unsigned int (*h)(Graph&, Node*, Node*)) {
+  return search::astar_basic(graph, start, goal, stats, h, *this);
+}
+
+uint8_t check_edit(const vector<Graph*> & graphs, const protocol::Request & request) {
+  if (request.map_index >= graphs.size())
+    return protocol::STATUS_BAD_MAP;
+  if (!graphs[request.map_index]->in_bounds(request.start_x, request.start_y))
+    return protocol::STATUS_BAD_NODE;
+  if (request.opcode == protocol::OP_SET_OPEN && request.goal_x > MAX_WEIGHT)
+    return protocol::STATUS_BAD_REQUEST;
+  return protocol::STATUS_OK;
+}
+
+void apply_edits(const vector<Graph*> & graphs, const vector<protocol::Request> & edits) {
+  for (auto& edit: edits) {
+    if (check_edit(graphs, edit) != protocol::STATUS_OK)
+      continue;
+    if (edit.opcode == protocol::OP_SET_BLOCKED)
+      graphs[edit.map_index]->set_blocked(edit.start_x, edit.start_y);
+    else
+      graphs[edit.map_index]->set_open(edit.start_x, edit.start_y,
+                                       edit.goal_x ? edit.goal_x : 1);
+  }
+  // Maps without edits are only read, since they may be shared (see edit_maps)
+  for (auto& graph: graphs)
+    if (!graph->pending_edits.empty())
+      graph->commit_edits();
+}
+
+shared_ptr<const MapVersion> edit_maps(const MapVersion & current,
+                                       const vector<protocol::Request> & edits) {
+  shared_ptr<MapVersion> next = make_shared<MapVersion>(current);
+  ++ next->version;
+  vector<bool> copied(next->graphs.size(), false);
+  for (auto& edit: edits) {
+    if (check_edit(next->graphs, edit) != protocol::STATUS_OK || copied[edit.map_index])
+      continue;
+    next->owners[edit.map_index] = make_shared<Graph>(*current.graphs[edit.map_index]);
+    next->graphs[edit.map_index] = next->owners[edit.map_index].get();
+    copied[edit.map_index] = true;
+  }
+  apply_edits(next->graphs, edits);
+  return next;
+}
+
+uint8_t solve(const vector<Graph*> & graphs, SearchSpace & space,
+              const protocol::Request & request, protocol::Response & response) {
+  if (request.map_index >= graphs.size())
+    return protocol::STATUS_BAD_MAP;
+  Graph & graph = *graphs[request.map_index];
+  if (!graph.in_bounds(request.start_x, request.start_y) ||
+      !graph.in_bounds(request.goal_x, request.goal_y))
+    return protocol::STATUS_BAD_NODE;
+  Node * start = graph.node_at(request.start_x, request.start_y);
+  Node * goal = graph.node_at(request.goal_x, request.goal_y);
+  if (!start || !goal)
+    return protocol::STATUS_BAD_NODE;
+
+  unsigned int (*h)(Graph&, Node*, Node*) =
+    graph.edge_type == EDGES_OCTILE ? &octile_heuristic : &man_heuristic;
+  Stats stats("");
+  bool found;
+  switch (request.algorithm) {
+  case protocol::ALG_ASTAR_HEAP: found = space.astar_heap(graph, start, goal, stats, h); break;
+  case protocol::ALG_FRINGE_SEARCH: found = space.fringe_search(graph, start, goal, stats, h); break;
+  case protocol::ALG_ASTAR_BASIC: found = space.astar_basic(graph, start, goal, stats, h); break;
+  default: return protocol::STATUS_BAD_REQUEST;
+  }
+  response.path_cost = stats.path_cost;
+  response.path_length = stats.path_length;
+  response.nodes_expanded = stats.nodes_expanded;
+  return found ? protocol::STATUS_OK : protocol::STATUS_NO_PATH;
+}
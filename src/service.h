@@ -0,0 +1,106 @@
+#ifndef SERVICE_H
+#define SERVICE_H
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "graph.h"
+#include "protocol.h"
+#include "stats.h"
+
+/// One thread's search state over graphs it shares with other threads.
+// The Node-based searches in algorithms.h keep their state inside the Nodes,
+// so two threads can't search the same Graph with them.  A SearchSpace keeps
+// the same variables in its own array, indexed by Node::graph_index, and runs
+// the same searches (see search.h) while only reading the graph.  Nodes are
+// closed by stamping them with the search's number, like problem_id.
+//
+// The graph mustn't change during a search.  Between searches it may be
+// edited freely, and a SearchSpace may move on to another graph; the array
+// grows to match.
+class SearchSpace {
+ public:
+  SearchSpace() { search = 0; }
+
+  /// The searches of the same names in algorithms.h.
+  bool astar_heap(Graph & graph, Node* ss, Node* gg, Stats & stats,
+                  unsigned int (*h)(Graph&, Node*, Node*));
+  bool fringe_search(Graph & graph, Node* ss, Node* gg, Stats & stats,
+                     unsigned int (*h)(Graph&, Node*, Node*));
+  bool astar_basic(Graph & graph, Node* ss, Node* gg, Stats & stats,
+                   unsigned int (*h)(Graph&, Node*, Node*));
+
+  // The State interface of search.h
+  void begin(Graph & graph, Stats & stats);
+  inline bool closed(Node* node) { return at(node).closed_id == search; }
+  inline void close(Node* node) {
+    at(node).closed_id = search;
+    at(node).open = false;
+  }
+  inline bool is_open(Node* node) { return at(node).open; }
+  inline void set_open(Node* node, bool open) { at(node).open = open; }
+  inline int g(Node* node) { return at(node).g; }
+  inline int f(Node* node) { return at(node).f; }
+  inline Node* whence(Node* node) { return at(node).whence; }
+  inline void set_whence(Node* node, Node* whence) { at(node).whence = whence; }
+  inline void relax(Node* node, int g, int h, Node* whence) {
+    State & state = at(node);
+    state.g = g;
+    state.f = g + h;
+    state.whence = whence;
+  }
+  inline int & heap_index(Node* node) { return at(node).heap_index; }
+  inline list<Node*>::iterator & fringe_index(Node* node) { return at(node).fringe_index; }
+
+ private:
+  struct State {
+    Node* whence;
+    list<Node*>::iterator fringe_index;
+    int g, f;
+    int heap_index;
+    unsigned int closed_id;           // the search that closed this node
+    bool open;
+    char reserved[7];
+  };
+
+  inline State & at(Node* node) { return states[node->graph_index]; }
+
+  vector<State> states;               // by graph_index
+  unsigned int search;
+  int reserved;
+};
+
+/// Request handling for the path-query server (see server.cpp), apart from
+/// the socket plumbing.  `graphs' are indexed by Request::map_index.
+
+/// Answer an OP_PATH request, filling in the path and search counters of
+/// `response', and return its status.
+uint8_t solve(const vector<Graph*> & graphs, SearchSpace & space,
+              const protocol::Request & request, protocol::Response & response);
+
+/// The status of an OP_SET_* request.
+uint8_t check_edit(const vector<Graph*> & graphs, const protocol::Request & request);
+
+/// Apply a batch of OP_SET_* requests, and commit them together.  Requests
+/// that fail check_edit are skipped.
+void apply_edits(const vector<Graph*> & graphs, const vector<protocol::Request> & edits);
+
+/// One version of every map.  A published version is never changed, so any
+/// number of threads can search it without locking; edits make a new version
+/// instead (see edit_maps).
+struct MapVersion {
+  vector<Graph*> graphs;              // by Request::map_index
+  vector<shared_ptr<Graph> > owners;  // keep `graphs' alive
+  unsigned int version;               // batches of edits applied
+  int reserved;
+};
+
+/// The version after applying a batch of OP_SET_* requests to `current', as
+/// apply_edits would.  Only the maps they touch are copied (see Graph's copy
+/// constructor); the rest are shared with `current', which is left unchanged.
+shared_ptr<const MapVersion> edit_maps(const MapVersion & current,
+                                       const vector<protocol::Request> & edits);
+
+#endif // SERVICE_H
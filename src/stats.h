@@ -11,6 +11,8 @@ class Stats {
   size_t nodes_expanded;        // nodes expanded to make path
   size_t path_length;           // number of nodes on path
   size_t open_list_size;        // size of open list at termination
+  size_t tiles_faulted;         // tiles paged in (TiledGrid searches only)
+  size_t direct_paths;          // problems answered by line of sight alone
   double path_cost;             // cumulative edge cost on path
   clock_t start_time;           // for timing
 
@@ -24,6 +26,8 @@ class Stats {
     nodes_expanded = 0;
     path_length = 0;
     open_list_size = 0;
+    tiles_faulted = 0;
+    direct_paths = 0;
     path_cost = 0;
     start_time = clock();
   }
@@ -40,6 +44,10 @@ class Stats {
     cout << " Mean path length: " << path_length / num_problems << endl;
     cout << " Mean path cost: " << path_cost / num_problems << endl;
     cout << " Mean open list size: " << open_list_size / num_problems << endl;
+    if (tiles_faulted)
+      cout << " Mean tiles faulted: " << tiles_faulted / (double) num_problems << endl;
+    if (direct_paths)
+      cout << " Direct paths: " << direct_paths << endl;
     cout << " Total time (sec): " << total_time() << endl;
   }
 };
@@ -1,11 +1,23 @@
 #ifndef TEST_H
 #define TEST_H
 
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <thread>
 #include <cassert>
+#include <climits>
+#include <cstdio>
+#include <cstring>
 #include "graph.h"
 #include "heuristics.h"
 #include "algorithms.h"
+#include "canonical_dijkstra.h"
+#include "profile.h"
+#include "protocol.h"
+#include "service.h"
 #include "stats.h"
+#include "workload.h"
 
 const int NUM_TEST_PROBLEMS = 10000;
 
@@ -35,4 +47,708 @@ int test_path_costs() {
   return 0;
 }
 
+int test_terrain_costs() {
+  Graph plain, doubled;
+  plain.load_ascii_map("../maps/terrain.map", EDGES_OCTILE);
+  doubled.load_ascii_map("../maps/terrain.map", EDGES_OCTILE);
+  doubled.grid_costs(4, 6);
+  assert(plain.min_weight == 1 && plain.max_weight == 3);
+
+  // Costs are configured per graph, and edge costs average the terrain weights
+  Node *road = plain.node_at(0, 0), *swamp = plain.node_at(1, 1);
+  assert(plain.cost(road, plain.node_at(1, 0)) == 2);
+  assert(plain.cost(road, swamp) == 3 * (1 + 3) / 2);
+  assert(doubled.cost(doubled.node_at(0, 0), doubled.node_at(1, 1)) == 6 * (1 + 3) / 2);
+
+  Stats stats_fringe("Fringe search"),
+    stats_astar_heap("A* with a heap"),
+    stats_astar_basic("A* (basic)"),
+    stats_astar_doubled("A* with doubled costs"),
+    stats_dijkstra("Dijkstra");
+  for (int ii = 0; ii < NUM_TEST_PROBLEMS; ++ ii) {
+    Node *ss = 0, *gg = 0;
+    while (ss == gg) {
+      ss = plain.random_node();
+      gg = plain.random_node();
+    }
+    Node *ss2 = doubled.node_at(ss->grid_x, ss->grid_y);
+    Node *gg2 = doubled.node_at(gg->grid_x, gg->grid_y);
+    fringe_search(plain, ss, gg, stats_fringe, &octile_heuristic);
+    astar_basic(plain, ss, gg, stats_astar_basic, &octile_heuristic);
+    astar_heap(plain, ss, gg, stats_dijkstra, &zero_heuristic);
+    astar_heap(plain, ss, gg, stats_astar_heap, &octile_heuristic);
+    astar_heap(doubled, ss2, gg2, stats_astar_doubled, &octile_heuristic);
+  }
+
+  // The scaled heuristic must stay admissible, so A* agrees with Dijkstra
+  size_t expected_path_cost = stats_dijkstra.path_cost;
+  assert(stats_astar_basic.path_cost == expected_path_cost);
+  assert(stats_fringe.path_cost == expected_path_cost);
+  assert(stats_astar_heap.path_cost == expected_path_cost);
+  assert(stats_astar_doubled.path_cost == 2 * expected_path_cost);
+
+  // Edits narrow the weight bounds as well as widen them
+  plain.set_open(0, 0, 7);
+  plain.commit_edits();
+  assert(plain.min_weight == 1 && plain.max_weight == 7);
+  for (int yy = 0; yy < plain.height; ++ yy)
+    for (int xx = 0; xx < plain.width; ++ xx)
+      if (plain.cell_weights[yy * plain.width + xx] > 1)
+        plain.set_open(xx, yy, 2);
+  plain.commit_edits();
+  assert(plain.min_weight == 1 && plain.max_weight == 2);
+
+  return 0;
+}
+
+/// Whether two graphs have the same cells, edges and edge costs.
+bool same_edges(Graph & g1, Graph & g2) {
+  for (int yy = 0; yy < g1.height; ++ yy) {
+    for (int xx = 0; xx < g1.width; ++ xx) {
+      Node *n1 = g1.node_at(xx, yy), *n2 = g2.node_at(xx, yy);
+      if (!n1 || !n2) {
+        if (n1 != n2)
+          return false;
+        continue;
+      }
+      vector<pair<pair<int, int>, unsigned int> > e1, e2;
+      for (size_t ii = 0; ii < n1->neighbors_out.size(); ++ ii)
+        e1.push_back(make_pair(make_pair(n1->neighbors_out[ii]->grid_x,
+                                         n1->neighbors_out[ii]->grid_y), n1->costs_out[ii]));
+      for (size_t ii = 0; ii < n2->neighbors_out.size(); ++ ii)
+        e2.push_back(make_pair(make_pair(n2->neighbors_out[ii]->grid_x,
+                                         n2->neighbors_out[ii]->grid_y), n2->costs_out[ii]));
+      sort(e1.begin(), e1.end());
+      sort(e2.begin(), e2.end());
+      if (e1 != e2 || n1->neighbors_in.size() != n1->neighbors_out.size())
+        return false;
+    }
+  }
+  return true;
+}
+
+int test_map_edits() {
+  Graph pristine, edited;
+  pristine.load_ascii_map("../maps/example.map", EDGES_OCTILE);
+  edited.load_ascii_map("../maps/example.map", EDGES_OCTILE);
+
+  // Block cells in batches, searching the edited map in between
+  vector<pair<int, int> > blocked;
+  Stats stats_astar_heap("A* with a heap"), stats_astar_basic("A* (basic)");
+  for (int batch = 0; batch < 20; ++ batch) {
+    for (int ii = 0; ii < 10; ++ ii) {
+      Node * nd = edited.random_node();
+      blocked.push_back(make_pair(nd->grid_x, nd->grid_y));
+      edited.set_blocked(nd->grid_x, nd->grid_y);
+    }
+    assert(edited.commit_edits() == (unsigned int) batch + 1);
+    for (int ii = 0; ii < 100; ++ ii) {
+      Node *ss = edited.random_node(), *gg = edited.random_node();
+      const bool found = astar_heap(edited, ss, gg, stats_astar_heap, &octile_heuristic);
+      assert(found == astar_basic(edited, ss, gg, stats_astar_basic, &octile_heuristic));
+    }
+    assert(stats_astar_heap.path_cost == stats_astar_basic.path_cost);
+  }
+  assert(!same_edges(pristine, edited));
+
+  // Reopening everything must restore the original edges, corner cuts included
+  for (auto& cell: blocked)
+    edited.set_open(cell.first, cell.second);
+  edited.commit_edits();
+  assert(edited.size() == pristine.size());
+  assert(same_edges(pristine, edited));
+  for (size_t ii = 0; ii < edited.size(); ++ ii)
+    assert(edited.graph_view[ii]->graph_index == (int) ii);
+
+  return 0;
+}
+
+int test_tiled_grid() {
+  Graph graph;
+  graph.load_ascii_map("../maps/terrain.map", EDGES_OCTILE);
+  const string tiled_filename = "test_terrain.tiled";
+  TiledGrid::convert_ascii_map("../maps/terrain.map", tiled_filename, graph.terrain, 4);
+
+  // A budget of two tiles forces plenty of evictions
+  TiledGrid grid;
+  grid.open(tiled_filename, 2);
+  assert(grid.width == graph.width && grid.height == graph.height);
+  assert(grid.min_weight == graph.min_weight && grid.max_weight == graph.max_weight);
+  for (int yy = 0; yy < graph.height; ++ yy)
+    for (int xx = 0; xx < graph.width; ++ xx)
+      assert(grid.weight(xx, yy) == graph.cell_weights[yy * graph.width + xx]);
+  assert(grid.resident() <= 2);
+
+  Stats stats_astar_heap("A* with a heap"), stats_astar_tiled("A* on tiles");
+  for (int ii = 0; ii < NUM_TEST_PROBLEMS; ++ ii) {
+    Node *ss = graph.random_node(), *gg = graph.random_node();
+    const bool found = astar_tiled(grid, ss->grid_x, ss->grid_y, gg->grid_x, gg->grid_y,
+                                   stats_astar_tiled);
+    assert(found == astar_heap(graph, ss, gg, stats_astar_heap, &octile_heuristic));
+  }
+  assert(stats_astar_tiled.path_cost == stats_astar_heap.path_cost);
+  assert(stats_astar_tiled.tiles_faulted > 0);
+  assert(!astar_tiled(grid, 2, 2, 0, 0, stats_astar_tiled)); // blocked start
+  grid.close();
+  remove(tiled_filename.c_str());
+
+  // A corridor wider than a Graph can hold, crossing 1094 tiles on a budget of 4
+  const string wide_filename = "test_wide.map", wide_tiled_filename = "test_wide.tiled";
+  const uint32_t wide = 70000;
+  {
+    ofstream file(wide_filename.c_str(), ios::out | ios::trunc);
+    file << "type octile" << endl << "height 3" << endl << "width " << wide << endl << "map" << endl;
+    for (int yy = 0; yy < 3; ++ yy)
+      file << string(wide, '.') << endl;
+  }
+  TiledGrid::convert_ascii_map(wide_filename, wide_tiled_filename, graph.terrain, 64);
+  grid.open(wide_tiled_filename, 4);
+  assert(grid.width == wide && grid.height == 3);
+  Stats stats_wide("A* on a wide map");
+  assert(astar_tiled(grid, 0, 1, wide - 1, 1, stats_wide));
+  assert(stats_wide.path_cost == (wide - 1) * grid.cardinal_cost);
+  assert(stats_wide.tiles_faulted >= grid.tiles_x);
+  assert(grid.resident() <= 4);
+  grid.close();
+  remove(wide_filename.c_str());
+  remove(wide_tiled_filename.c_str());
+  return 0;
+}
+
+int test_hda_star() {
+  Graph graph;
+  graph.load_ascii_map("../maps/terrain.map", EDGES_OCTILE);
+  Graph example;
+  example.load_ascii_map("../maps/example.map", EDGES_OCTILE);
+
+  for (size_t threads = 1; threads <= 4; ++ threads) {
+    Stats stats_astar_heap("A* with a heap"), stats_hda_star("HDA*");
+    for (int ii = 0; ii < NUM_TEST_PROBLEMS / 10; ++ ii) {
+      Graph & gr = ii % 2 ? graph : example;
+      Node *ss = gr.random_node(), *gg = gr.random_node();
+      const bool found = hda_star(gr, ss, gg, stats_hda_star, &octile_heuristic, threads);
+      assert(found == astar_heap(gr, ss, gg, stats_astar_heap, &octile_heuristic));
+    }
+    assert(stats_hda_star.path_cost == stats_astar_heap.path_cost);
+  }
+
+  // Wall off the goal
+  Stats stats_hda_star("HDA*");
+  Node * goal = example.node_at(20, 0);
+  for (auto& neighbor: vector<Node*>(goal->neighbors_out.begin(), goal->neighbors_out.end()))
+    example.set_blocked(neighbor->grid_x, neighbor->grid_y);
+  example.commit_edits();
+  assert(!hda_star(example, example.node_at(0, 3), goal, stats_hda_star, &octile_heuristic, 3));
+  return 0;
+}
+
+int test_reorder() {
+  Graph pristine;
+  pristine.load_ascii_map("../maps/example.map", EDGES_OCTILE);
+  NodeOrder orders[3] = {ORDER_MORTON, ORDER_HILBERT, ORDER_BLOCKS};
+  for (auto& order: orders) {
+    Graph graph;
+    graph.load_ascii_map("../maps/example.map", EDGES_OCTILE);
+    graph.reorder(order);
+    assert(graph.size() == pristine.size());
+    assert(same_edges(pristine, graph));
+    for (size_t ii = 0; ii < graph.size(); ++ ii) {
+      Node * node = graph.graph_view[ii];
+      assert(node->graph_index == (int) ii);
+      assert(graph.node_at(node->grid_x, node->grid_y) == node);
+    }
+
+    Stats stats_pristine("A* with a heap"), stats_reordered("A* with a heap, reordered");
+    for (int ii = 0; ii < NUM_TEST_PROBLEMS / 10; ++ ii) {
+      Node *ss = pristine.random_node(), *gg = pristine.random_node();
+      astar_heap(pristine, ss, gg, stats_pristine, &octile_heuristic);
+      astar_heap(graph, graph.node_at(ss->grid_x, ss->grid_y),
+                 graph.node_at(gg->grid_x, gg->grid_y), stats_reordered, &octile_heuristic);
+    }
+    assert(stats_reordered.path_cost == stats_pristine.path_cost);
+  }
+
+  // Reordering at load time lays the nodes and their edges out contiguously
+  Graph graph;
+  graph.load_ascii_map("../maps/example.map", EDGES_OCTILE, false, false, ORDER_HILBERT);
+  assert(same_edges(pristine, graph));
+  assert(graph.packed_nodes.size() == graph.size());
+  for (size_t ii = 0; ii < graph.size(); ++ ii) {
+    Node * node = graph.graph_view[ii];
+    assert(node == &graph.packed_nodes[ii]);
+    if (ii + 1 < graph.size())
+      assert(node->neighbors_out.end() == graph.graph_view[ii + 1]->neighbors_out.begin());
+  }
+
+  // Edits and a second reorder leave the same edges as on an unordered map
+  for (int ii = 0; ii < 50; ++ ii) {
+    Node * nd = pristine.random_node();
+    pristine.set_blocked(nd->grid_x, nd->grid_y);
+    graph.set_blocked(nd->grid_x, nd->grid_y);
+  }
+  pristine.commit_edits();
+  graph.commit_edits();
+  pristine.set_open(20, 0);
+  graph.set_open(20, 0);
+  pristine.commit_edits();
+  graph.commit_edits();
+  assert(same_edges(pristine, graph));
+  graph.reorder(ORDER_MORTON);
+  assert(same_edges(pristine, graph));
+  assert(graph.packed_nodes.size() == graph.size());
+  for (size_t ii = 0; ii < graph.size(); ++ ii)
+    assert(graph.graph_view[ii]->graph_index == (int) ii);
+
+  // A copy keeps the order, and shares nothing with the original
+  Graph copy(graph);
+  assert(same_edges(pristine, copy));
+  for (size_t ii = 0; ii < copy.size(); ++ ii) {
+    assert(copy.graph_view[ii] == &copy.packed_nodes[ii]);
+    assert(copy.graph_view[ii]->grid_x == graph.graph_view[ii]->grid_x);
+    assert(copy.graph_view[ii]->grid_y == graph.graph_view[ii]->grid_y);
+  }
+  copy.set_blocked(20, 0);
+  copy.commit_edits();
+  assert(same_edges(pristine, graph) && !same_edges(pristine, copy));
+  return 0;
+}
+
+int test_block_astar() {
+  // Round trip the database through a file
+  LocalDistanceDatabase built, loaded;
+  built.build(2, 3, false);
+  const string filename = built.filename(".");
+  built.save(filename);
+  loaded.cardinal_cost = 2;
+  loaded.diagonal_cost = 3;
+  loaded.corner_cut = true;
+  assert(!loaded.load(filename));      // wrong corner-cutting rule
+  loaded.corner_cut = false;
+  assert(loaded.load(filename) && loaded.loaded_from_disk);
+  assert(loaded.distances == built.distances);
+  remove(filename.c_str());
+  const uint32_t open = (1 << LocalDistanceDatabase::CELLS) - 1;
+  assert(built.distance(open, 0, 15) == 9 && built.distance(open, 0, 3) == 6);
+  assert(built.distance(1 << 0 | 1 << 5, 0, 5) == LocalDistanceDatabase::UNREACHABLE);
+
+  // Threads asking for the same settings at once get one database, cached in
+  // the directory they name
+  vector<LocalDistanceDatabase*> shared(4);
+  vector<thread> threads;
+  for (size_t ii = 0; ii < shared.size(); ++ ii) {
+    threads.push_back(thread([&shared, ii] {
+      shared[ii] = &LocalDistanceDatabase::cached(3, 4, true, "../maps");
+    }));
+  }
+  for (auto& th: threads)
+    th.join();
+  for (auto& lddb: shared)
+    assert(lddb == shared[0]);
+  const string cached_filename = shared[0]->filename("../maps");
+  assert(ifstream(cached_filename.c_str()).good());
+  remove(cached_filename.c_str());
+
+  bool corner_cuts[2] = {false, true};
+  for (auto& corner_cut: corner_cuts) {
+    Graph graph;
+    graph.load_ascii_map("../maps/example.map", EDGES_OCTILE, corner_cut);
+    graph.grid_costs(5, 7);
+    LocalDistanceDatabase lddb;
+    lddb.build(5, 7, corner_cut);
+    Stats stats_astar_heap("A* with a heap"), stats_block_astar("Block A*");
+    for (int ii = 0; ii < NUM_TEST_PROBLEMS / 10; ++ ii) {
+      Node *ss = graph.random_node(), *gg = graph.random_node();
+      const bool found = block_astar(graph, ss, gg, stats_block_astar, &octile_heuristic, lddb);
+      assert(found == astar_heap(graph, ss, gg, stats_astar_heap, &octile_heuristic));
+    }
+    assert(stats_block_astar.path_cost == stats_astar_heap.path_cost);
+  }
+  return 0;
+}
+
+/// The bitboard agrees with the graph and with the cell-at-a-time check, and
+/// visible lines follow the graph's edges.
+void check_line_of_sight(Graph & graph, bool corner_cut) {
+  for (int yy = 0; yy < graph.height; ++ yy)
+    for (int xx = 0; xx < graph.width; ++ xx)
+      assert(graph.passable.get(xx, yy) == (graph.node_at(xx, yy) != 0));
+
+  // Random pairs, nearby pairs, and pairs on the same row or column (which
+  // span several words of the bitboard on wide or tall maps)
+  size_t visible = 0;
+  vector<pair<int, int> > cells;
+  for (int ii = 0; ii < NUM_TEST_PROBLEMS; ++ ii) {
+    Node *ss = graph.random_node(), *gg = graph.random_node();
+    if (ii % 4 == 1)
+      gg = graph.node_at(min(graph.width - 1, ss->grid_x + rand() % 9),
+                         max(0, ss->grid_y - rand() % 9));
+    else if (ii % 4 == 2)
+      gg = graph.node_at(gg->grid_x, ss->grid_y);
+    else if (ii % 4 == 3)
+      gg = graph.node_at(ss->grid_x, gg->grid_y);
+    if (!gg)
+      continue;
+    const bool los = graph.line_of_sight(ss, gg);
+    assert(los == graph.passable.line_of_sight_cellwise(ss->grid_x, ss->grid_y,
+                                                        gg->grid_x, gg->grid_y, corner_cut));
+    assert(los == graph.line_of_sight(gg, ss));
+    if (!los)
+      continue;
+    ++ visible;
+    cells.clear();
+    graph.passable.octile_line(ss->grid_x, ss->grid_y, gg->grid_x, gg->grid_y, cells);
+    assert(cells.front() == make_pair(ss->grid_x, ss->grid_y));
+    assert(cells.back() == make_pair(gg->grid_x, gg->grid_y));
+    for (size_t jj = 1; jj < cells.size(); ++ jj) {
+      Node * from = graph.node_at(cells[jj - 1].first, cells[jj - 1].second);
+      Node * to = graph.node_at(cells[jj].first, cells[jj].second);
+      assert(find(from->neighbors_out.begin(), from->neighbors_out.end(), to) !=
+             from->neighbors_out.end());
+    }
+  }
+  assert(visible > 0);
+}
+
+int test_line_of_sight() {
+  bool corner_cuts[2] = {false, true};
+  for (auto& corner_cut: corner_cuts) {
+    // random-256 is wider than a word and taller than a column word
+    Graph random;
+    random.load_ascii_map("../maps/random-256.map", EDGES_OCTILE, corner_cut);
+    check_line_of_sight(random, corner_cut);
+
+    Graph graph;
+    graph.load_ascii_map("../maps/example.map", EDGES_OCTILE, corner_cut);
+    check_line_of_sight(graph, corner_cut);
+
+    // Smoothed paths cost no more than the paths they came from
+    for (int ii = 0; ii < NUM_TEST_PROBLEMS / 10; ++ ii) {
+      Node *ss = graph.random_node(), *gg = graph.random_node();
+      Stats stats("Fringe search");
+      const bool found = fringe_search(graph, ss, gg, stats, &octile_heuristic);
+      assert(found);
+      vector<Node*> path(1, gg);
+      while (path.back() != ss)
+        path.push_back(path.back()->whence);
+      reverse(path.begin(), path.end());
+      smooth_path(graph, path);
+      assert(path.front() == ss && path.back() == gg);
+      unsigned int cost = 0;
+      for (size_t jj = 1; jj < path.size(); ++ jj) {
+        assert(graph.line_of_sight(path[jj - 1], path[jj]));
+        cost += octile_heuristic(graph, path[jj - 1], path[jj]);
+      }
+      assert(cost <= stats.path_cost);
+    }
+
+    // Edits reach the bitboard
+    Node * node = graph.random_node();
+    const int xx = node->grid_x, yy = node->grid_y;
+    graph.set_blocked(xx, yy);
+    graph.commit_edits();
+    assert(!graph.passable.get(xx, yy));
+    graph.set_open(xx, yy);
+    graph.commit_edits();
+    assert(graph.passable.get(xx, yy));
+  }
+
+  // The direct path fast path is taken, and agrees with search
+  Graph graph;
+  graph.load_ascii_map("../maps/example.map", EDGES_OCTILE);
+  Stats stats_astar_heap("A* with a heap"), stats_fringe("Fringe search");
+  for (int ii = 0; ii < NUM_TEST_PROBLEMS; ++ ii) {
+    Node *ss = graph.random_node(), *gg = graph.random_node();
+    astar_heap(graph, ss, gg, stats_astar_heap, &octile_heuristic);
+    fringe_search(graph, ss, gg, stats_fringe, &octile_heuristic);
+  }
+  assert(stats_astar_heap.direct_paths > 0);
+  assert(stats_astar_heap.path_cost == stats_fringe.path_cost);
+  return 0;
+}
+
+int test_workload() {
+  // SplitMix64's published first output for seed 0
+  Rng rng(0);
+  assert(rng.next() == 0xe220a8397b1dcdafULL);
+
+  Graph graph;
+  graph.load_ascii_map("../maps/example.map", EDGES_OCTILE);
+  vector<unsigned int> costs;
+  Node * start = graph.node_at(0, 3);
+  optimal_costs(graph, start, costs);
+  assert(validate_costs(graph, start, costs));
+  for (int ii = 0; ii < NUM_TEST_PROBLEMS / 10; ++ ii) {
+    Node * goal = graph.random_node();
+    Stats stats_astar_heap("A* with a heap");
+    astar_heap(graph, start, goal, stats_astar_heap, &octile_heuristic);
+    assert(stats_astar_heap.path_cost == costs[goal->graph_index]);
+  }
+  for (auto& cost: costs) {
+    if (cost > 0 && cost != UINT_MAX) {
+      -- cost;                        // too cheap to be reached
+      assert(!validate_costs(graph, start, costs));
+      ++ cost;
+      ++ cost;                        // too dear given its neighbors
+      assert(!validate_costs(graph, start, costs));
+      -- cost;
+      break;
+    }
+  }
+
+  // Same seed, same workload; and it survives a round trip to disk
+  Workload workload, again, loaded;
+  workload.generate(graph, "../maps/example.map", 7, 5, 10);
+  again.generate(graph, "../maps/example.map", 7, 5, 10);
+  assert(workload.queries.size() == 50);
+  const string filename = "test_example.workload";
+  workload.save(filename);
+  assert(loaded.load(filename));
+  remove(filename.c_str());
+  assert(loaded.map_filename == workload.map_filename && loaded.seed == 7);
+  assert(loaded.num_buckets == 5 && loaded.bucket_width == workload.bucket_width);
+  for (size_t ii = 0; ii < workload.queries.size(); ++ ii) {
+    Query & query = workload.queries[ii];
+    assert(!memcmp(&query, &again.queries[ii], sizeof(Query)));
+    assert(!memcmp(&query, &loaded.queries[ii], sizeof(Query)));
+    assert(query.cost / workload.bucket_width == query.bucket);
+    optimal_costs(graph, graph.node_at(query.start_x, query.start_y), costs);
+    assert(costs[graph.node_at(query.goal_x, query.goal_y)->graph_index] == query.cost);
+  }
+  return 0;
+}
+
+int test_profile() {
+  // Time nested phases on two threads, directly (PROFILE_SCOPE may be
+  // compiled out)
+  PhaseProfile::reset();
+  auto work = []() {
+    for (int ii = 0; ii < 3; ++ ii) {
+      ScopedPhase outer("test_outer");
+      for (int jj = 0; jj < 2; ++ jj)
+        ScopedPhase inner("test_inner");
+    }
+  };
+  thread other(work);
+  other.join();
+  work();
+  PhaseProfile & local = PhaseProfile::local();
+  assert(local.current == 0 && local.phases.size() >= 3);
+  for (auto& phase: local.phases) {
+    if (phase.name == string("test_outer"))
+      assert(phase.calls == 3 && phase.parent == 0);
+    if (phase.name == string("test_inner"))
+      assert(phase.calls == 6 && local.phases[phase.parent].name == string("test_outer") &&
+             phase.ticks <= local.phases[phase.parent].ticks);
+  }
+
+  // One folded stack per thread and phase
+  const string filename = "test_profile.folded";
+  PhaseProfile::write_folded(filename);
+  ifstream folded(filename.c_str());
+  string line;
+  size_t outer = 0, inner = 0;
+  while (getline(folded, line)) {
+    const string stack = line.substr(0, line.rfind(' '));
+    assert(stack.compare(0, 7, "thread-") == 0);
+    outer += stack.size() > 11 && stack.compare(stack.size() - 11, 11, ";test_outer") == 0;
+    inner += stack.find(";test_outer;test_inner") != string::npos;
+  }
+  folded.close();
+  remove(filename.c_str());
+  assert(outer == 2 && inner == 2);
+  return 0;
+}
+
+/// Check every canonical sweep against the oracle, from a sample of sources.
+void check_canonical_sweeps(Graph & graph, int num_sources) {
+  CanonicalDijkstra engine(graph);
+  vector<unsigned int> distances(graph.width * graph.height), costs;
+  for (int ii = 0; ii < num_sources; ++ ii) {
+    Node * source = graph.random_node();
+    engine.sweep(source->grid_x, source->grid_y, distances.data());
+    optimal_costs(graph, source, costs);
+    for (int yy = 0; yy < graph.height; ++ yy) {
+      for (int xx = 0; xx < graph.width; ++ xx) {
+        Node * node = graph.node_at(xx, yy);
+        assert(distances[yy * graph.width + xx] == (node ? costs[node->graph_index] : UINT_MAX));
+      }
+    }
+  }
+}
+
+int test_canonical_dijkstra() {
+  int test_costs[4][2] = {{2, 3}, {1, 1}, {5, 7}, {2, 4}};
+  bool corner_cuts[2] = {false, true};
+  for (auto& corner_cut: corner_cuts) {
+    Graph example, random_map;
+    example.load_ascii_map("../maps/example.map", EDGES_OCTILE, corner_cut);
+    random_map.load_ascii_map("../maps/random-256.map", EDGES_OCTILE, corner_cut);
+    for (auto& costs: test_costs) {
+      example.grid_costs(costs[0], costs[1]);
+      random_map.grid_costs(costs[0], costs[1]);
+      check_canonical_sweeps(example, 50);
+      check_canonical_sweeps(random_map, 3);
+    }
+  }
+
+  // Sweeping many sources on several threads gives the same distances
+  Graph graph;
+  graph.load_ascii_map("../maps/example.map", EDGES_OCTILE);
+  CanonicalDijkstra engine(graph);
+  vector<pair<int, int> > sources;
+  for (int ii = 0; ii < 20; ++ ii) {
+    Node * source = graph.random_node();
+    sources.push_back(make_pair(source->grid_x, source->grid_y));
+  }
+  const size_t cells = graph.width * graph.height;
+  vector<unsigned int> together(sources.size() * cells), alone(cells);
+  engine.sweep_all(sources, together.data(), 3);
+  for (size_t ii = 0; ii < sources.size(); ++ ii) {
+    engine.sweep(sources[ii].first, sources[ii].second, alone.data());
+    assert(equal(alone.begin(), alone.end(), together.begin() + ii * cells));
+  }
+  return 0;
+}
+
+/// Answer a batch of encoded requests the way a server worker does, and
+/// return the encoded responses.
+string answer_batch(const vector<Graph*> & graphs, SearchSpace & space, const string & batch) {
+  vector<protocol::Request> requests;
+  assert(protocol::decode(batch.data(), batch.size(), requests) == batch.size());
+  string out;
+  for (auto& request: requests) {
+    protocol::Response response;
+    memset(&response, 0, sizeof(response));
+    response.id = request.id;
+    response.opcode = request.opcode;
+    response.status = solve(graphs, space, request, response);
+    protocol::encode(response, out);
+  }
+  return out;
+}
+
+int test_server() {
+  shared_ptr<Graph> shared = make_shared<Graph>();
+  Graph reference;
+  shared->load_ascii_map("../maps/example.map", EDGES_OCTILE);
+  reference.load_ascii_map("../maps/example.map", EDGES_OCTILE);
+  vector<Graph*> graphs(1, shared.get());
+
+  // Two batches of every algorithm, answered at once by two workers
+  const int num_requests = NUM_TEST_PROBLEMS / 10;
+  vector<protocol::Request> requests;
+  string batches[2];
+  for (int ii = 0; ii < num_requests; ++ ii) {
+    Node *ss = reference.random_node(), *gg = reference.random_node();
+    protocol::Request request;
+    memset(&request, 0, sizeof(request));
+    request.id = ii;
+    request.opcode = protocol::OP_PATH;
+    request.algorithm = ii % 3;
+    request.start_x = ss->grid_x;
+    request.start_y = ss->grid_y;
+    request.goal_x = gg->grid_x;
+    request.goal_y = gg->grid_y;
+    requests.push_back(request);
+    protocol::encode(request, batches[ii % 2]);
+  }
+  // A trailing partial request is left for the next read
+  vector<protocol::Request> decoded;
+  assert(protocol::decode(batches[0].data(), batches[0].size() - 1, decoded) ==
+         batches[0].size() - sizeof(protocol::Request));
+  assert(decoded.size() == (size_t) (num_requests + 1) / 2 - 1);
+
+  string answers[2];
+  vector<thread> workers;
+  for (size_t ww = 0; ww < 2; ++ ww) {
+    workers.push_back(thread([&graphs, &batches, &answers, ww] {
+      SearchSpace space;
+      answers[ww] = answer_batch(graphs, space, batches[ww]);
+    }));
+  }
+  for (auto& th: workers)
+    th.join();
+  size_t answered = 0;
+  for (auto& answer: answers) {
+    vector<protocol::Response> responses;
+    protocol::decode(answer.data(), answer.size(), responses);
+    for (auto& response: responses) {
+      const protocol::Request & request = requests[response.id];
+      Node * ss = reference.node_at(request.start_x, request.start_y);
+      Node * gg = reference.node_at(request.goal_x, request.goal_y);
+      // The same search on the Node-based entry point does the same work
+      Stats stats("Reference");
+      bool (*algorithms[3])(Graph&, Node*, Node*, Stats&, unsigned int (*)(Graph&, Node*, Node*)) =
+        {&astar_heap, &fringe_search, &astar_basic};
+      assert(response.status == protocol::STATUS_OK);
+      assert(algorithms[request.algorithm](reference, ss, gg, stats, &octile_heuristic));
+      assert(response.path_cost == stats.path_cost);
+      assert(response.path_length == stats.path_length);
+      assert(response.nodes_expanded == stats.nodes_expanded);
+      ++ answered;
+    }
+  }
+  assert(answered == requests.size());
+
+  // Wall off a goal with a batch of edits.  The same searches then fail on
+  // the new version of the maps, and still succeed on the old one.
+  Node * goal = reference.node_at(20, 0);
+  vector<protocol::Request> edits;
+  for (auto& neighbor: vector<Node*>(goal->neighbors_out.begin(), goal->neighbors_out.end())) {
+    protocol::Request edit;
+    memset(&edit, 0, sizeof(edit));
+    edit.opcode = protocol::OP_SET_BLOCKED;
+    edit.start_x = neighbor->grid_x;
+    edit.start_y = neighbor->grid_y;
+    edits.push_back(edit);
+  }
+  MapVersion before;
+  before.graphs = graphs;
+  before.owners.push_back(shared);
+  before.version = 0;
+  shared_ptr<const MapVersion> after = edit_maps(before, edits);
+  assert(after->version == 1 && after->graphs[0] != shared.get());
+  assert(after->graphs[0]->version == 1 && shared->version == 0);
+  SearchSpace space;
+  for (int algorithm = 0; algorithm < 3; ++ algorithm) {
+    protocol::Request request;
+    memset(&request, 0, sizeof(request));
+    request.opcode = protocol::OP_PATH;
+    request.algorithm = algorithm;
+    request.goal_x = 20;
+    request.start_y = 3;
+    protocol::Response response;
+    assert(solve(after->graphs, space, request, response) == protocol::STATUS_NO_PATH);
+    assert(solve(graphs, space, request, response) == protocol::STATUS_OK);
+    request.start_x = 20;
+    request.start_y = 0;
+    request.goal_y = 3;
+    assert(solve(after->graphs, space, request, response) == protocol::STATUS_NO_PATH);
+    assert(solve(graphs, space, request, response) == protocol::STATUS_OK);
+  }
+
+  // Malformed requests
+  protocol::Request request = requests[0];
+  protocol::Response response;
+  request.map_index = 1;
+  assert(solve(graphs, space, request, response) == protocol::STATUS_BAD_MAP);
+  assert(check_edit(graphs, request) == protocol::STATUS_BAD_MAP);
+  request.map_index = 0;
+  request.goal_x = shared->width;
+  assert(solve(graphs, space, request, response) == protocol::STATUS_BAD_NODE);
+  request = edits[0];
+  request.opcode = protocol::OP_PATH;
+  assert(solve(after->graphs, space, request, response) == protocol::STATUS_BAD_NODE);
+  request = requests[0];
+  request.algorithm = 3;
+  assert(solve(graphs, space, request, response) == protocol::STATUS_BAD_REQUEST);
+  request = edits[0];
+  request.opcode = protocol::OP_SET_OPEN;
+  request.goal_x = MAX_WEIGHT;
+  assert(check_edit(graphs, request) == protocol::STATUS_OK);
+  request.goal_x = MAX_WEIGHT + 1;
+  assert(check_edit(graphs, request) == protocol::STATUS_BAD_REQUEST);
+  return 0;
+}
+
 #endif // TEST_H
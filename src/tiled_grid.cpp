@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+using namespace std;
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "tiled_grid.h"
+
+const size_t PAGE_SIZE = 4096;
+const char TILED_MAGIC[4] = {'T', 'G', 'R', 'D'};
+
+struct TiledHeader {
+  char magic[4];
+  uint32_t tile_size;
+  uint32_t width, height;
+  uint32_t min_weight, max_weight;
+};
+
+inline size_t page_aligned_tile_bytes(uint32_t tile_size) {
+  const size_t bytes = tile_size * tile_size;
+  return (bytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+}
+
+TiledGrid::TiledGrid() {
+  fd = -1;
+  width = height = 0;
+  tile_size = tiles_x = tiles_y = 0;
+  tile_shift = 0;
+  tile_stride = 0;
+  min_weight = max_weight = 1;
+  cardinal_cost = 2;
+  diagonal_cost = 3;
+  max_resident = 0;
+  faults = 0;
+  current_tile = UINT32_MAX;
+  current_cells = 0;
+}
+
+/// Stream an ascii map into tiles, buffering only one row of tiles at a time.
+void TiledGrid::convert_ascii_map(string ascii_filename, string tiled_filename,
+                                  const vector<unsigned int> & terrain,
+                                  uint32_t tile_size) {
+  assert(tile_size && !(tile_size & (tile_size - 1)));
+  ifstream map_file(ascii_filename.c_str(), ios::in);
+  assert(map_file.good());
+  TiledHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TILED_MAGIC, sizeof(header.magic));
+  header.tile_size = tile_size;
+  while (!map_file.eof()) {
+    string token;
+    map_file >> token;
+    if (token == "width")
+      map_file >> header.width;
+    else if (token == "height")
+      map_file >> header.height;
+    else if (token == "map")
+      break;
+  }
+
+  ofstream tiled_file(tiled_filename.c_str(), ios::out | ios::binary | ios::trunc);
+  assert(tiled_file.good());
+  const uint32_t tiles_x = (header.width + tile_size - 1) / tile_size;
+  const size_t stride = page_aligned_tile_bytes(tile_size);
+  vector<uint8_t> tile_row(tiles_x * stride);
+  string row;
+  header.min_weight = UINT32_MAX;
+  header.max_weight = 0;
+  for (uint32_t yy = 0; yy < header.height; ++ yy) {
+    if (yy % tile_size == 0)
+      fill(tile_row.begin(), tile_row.end(), 0);
+    map_file >> row;
+    for (uint32_t xx = 0; xx < header.width; ++ xx) {
+      const unsigned int weight = terrain[(unsigned char) row[xx]];
+      assert(weight < 256);
+      if (weight && weight < header.min_weight)
+        header.min_weight = weight;
+      if (weight > header.max_weight)
+        header.max_weight = weight;
+      tile_row[(xx / tile_size) * stride + (yy % tile_size) * tile_size + xx % tile_size] = weight;
+    }
+    if (yy % tile_size == tile_size - 1 || yy == header.height - 1) {
+      tiled_file.seekp(PAGE_SIZE + (yy / tile_size) * tiles_x * stride);
+      tiled_file.write((const char*) tile_row.data(), tile_row.size());
+    }
+  }
+  if (!header.max_weight)
+    header.min_weight = header.max_weight = 1;
+  vector<char> header_page(PAGE_SIZE, 0);
+  memcpy(header_page.data(), &header, sizeof(header));
+  tiled_file.seekp(0);
+  tiled_file.write(header_page.data(), header_page.size());
+  assert(tiled_file.good());
+}
+
+void TiledGrid::open(string filename, size_t max_resident) {
+  close();
+  assert(max_resident > 0);
+  fd = ::open(filename.c_str(), O_RDONLY);
+  assert(fd >= 0);
+  TiledHeader header;
+  ssize_t got = pread(fd, &header, sizeof(header), 0);
+  assert(got == sizeof(header) && !memcmp(header.magic, TILED_MAGIC, sizeof(header.magic)));
+  (void) got;
+  width = header.width;
+  height = header.height;
+  tile_size = header.tile_size;
+  min_weight = header.min_weight;
+  max_weight = header.max_weight;
+  tiles_x = (width + tile_size - 1) / tile_size;
+  tiles_y = (height + tile_size - 1) / tile_size;
+  tile_shift = __builtin_ctz(tile_size);
+  tile_stride = page_aligned_tile_bytes(tile_size);
+  this->max_resident = max_resident;
+  faults = 0;
+}
+
+void TiledGrid::close() {
+  for (auto& entry: tiles)
+    munmap((void*) entry.second.cells, tile_stride);
+  tiles.clear();
+  lru.clear();
+  current_tile = UINT32_MAX;
+  current_cells = 0;
+  if (fd >= 0)
+    ::close(fd);
+  fd = -1;
+}
+
+void TiledGrid::grid_costs(int new_cardinal_cost, int new_diagonal_cost) {
+  assert(new_cardinal_cost > 0 && new_diagonal_cost > 0);
+  cardinal_cost = new_cardinal_cost;
+  diagonal_cost = new_diagonal_cost;
+}
+
+/// Make `tile' the current tile, mapping it in (and evicting the least
+/// recently used tile) if it isn't resident.
+void TiledGrid::fetch(uint32_t tile) {
+  auto found = tiles.find(tile);
+  if (found != tiles.end()) {
+    lru.splice(lru.begin(), lru, found->second.lru_position);
+    current_tile = tile;
+    current_cells = found->second.cells;
+    return;
+  }
+  if (tiles.size() >= max_resident) {
+    const uint32_t victim = lru.back();
+    munmap((void*) tiles[victim].cells, tile_stride);
+    tiles.erase(victim);
+    lru.pop_back();
+  }
+  void * cells = mmap(0, tile_stride, PROT_READ, MAP_PRIVATE, fd, PAGE_SIZE + tile * tile_stride);
+  assert(cells != MAP_FAILED);
+  lru.push_front(tile);
+  Tile & entry = tiles[tile];
+  entry.cells = (const uint8_t*) cells;
+  entry.lru_position = lru.begin();
+  current_tile = tile;
+  current_cells = entry.cells;
+  ++ faults;
+}
@@ -0,0 +1,70 @@
+#ifndef TILED_GRID_H
+#define TILED_GRID_H
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+/// A grid map that lives on disk as square tiles of terrain weights.
+// Unlike Graph, there's no Node per cell: tiles are mapped in with mmap when a
+// search first touches them, and at most `max_resident' tiles stay mapped (the
+// least recently used one is unmapped to make room).  Coordinates are 32 bits.
+//
+// The file starts with a one-page header, followed by the tiles in row-major
+// order, each padded out to a whole number of pages so it can be mapped alone.
+class TiledGrid {
+ public:
+  TiledGrid();
+  ~TiledGrid() { this->close(); }
+
+  /// Convert an ascii map (see Graph::load_ascii_map) to a tiled map file.
+  /// `terrain' gives the weight of each glyph, as in Graph::terrain.
+  static void convert_ascii_map(string ascii_filename, string tiled_filename,
+                                const vector<unsigned int> & terrain,
+                                uint32_t tile_size = 64);
+
+  void open(string filename, size_t max_resident = 256);
+  void close();
+  void grid_costs(int new_cardinal_cost, int new_diagonal_cost);
+
+  size_t max_resident;           // tile budget
+  size_t faults;                 // tiles mapped in since open()
+  uint32_t width, height;
+  uint32_t tile_size;            // a power of two
+  uint32_t tiles_x, tiles_y;     // number of tiles across and down
+  uint32_t min_weight, max_weight;
+  int cardinal_cost, diagonal_cost;
+
+  /// Terrain weight of a cell; 0 if it's blocked or off the map.
+  inline uint8_t weight(uint32_t x, uint32_t y) {
+    if (x >= width || y >= height)
+      return 0;
+    const uint32_t tile = (y >> tile_shift) * tiles_x + (x >> tile_shift);
+    if (tile != current_tile)
+      fetch(tile);
+    const uint32_t mask = tile_size - 1;
+    return current_cells[((y & mask) << tile_shift) + (x & mask)];
+  }
+
+  inline size_t resident() { return tiles.size(); }
+
+ private:
+  struct Tile {
+    const uint8_t * cells;
+    list<uint32_t>::iterator lru_position;
+  };
+
+  void fetch(uint32_t tile);
+
+  int fd;
+  uint32_t tile_shift;           // log2(tile_size)
+  uint32_t current_tile;         // most recently fetched tile
+  size_t tile_stride;            // bytes per tile in the file
+  const uint8_t * current_cells;
+  unordered_map<uint32_t, Tile> tiles;
+  list<uint32_t> lru;            // resident tiles, most recently used first
+};
+
+#endif // TILED_GRID_H
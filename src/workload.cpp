@@ -0,0 +1,158 @@
+#include <fstream>
+#include <functional>
+#include <queue>
+using namespace std;
+#include <cassert>
+#include <climits>
+#include "workload.h"
+
+const int WORKLOAD_VERSION = 1;
+
+void optimal_costs(Graph & graph, Node * start, vector<unsigned int> & costs) {
+  typedef pair<unsigned int, int> Entry;   // (cost, graph_index)
+  priority_queue<Entry, vector<Entry>, greater<Entry> > open_list;
+  costs.assign(graph.size(), UINT_MAX);
+  costs[start->graph_index] = 0;
+  open_list.push(make_pair(0, start->graph_index));
+  while (!open_list.empty()) {
+    const Entry entry = open_list.top();
+    open_list.pop();
+    if (entry.first > costs[entry.second])
+      continue;                            // stale
+    Node * expand_me = graph.graph_view[entry.second];
+    for (size_t ii = 0; ii < expand_me->neighbors_out.size(); ++ ii) {
+      const int index = expand_me->neighbors_out[ii]->graph_index;
+      const unsigned int cost = entry.first + expand_me->costs_out[ii];
+      if (cost < costs[index]) {
+        costs[index] = cost;
+        open_list.push(make_pair(cost, index));
+      }
+    }
+  }
+}
+
+bool validate_costs(Graph & graph, Node * start, vector<unsigned int> & costs) {
+  if (costs.size() != graph.size() || costs[start->graph_index] != 0)
+    return false;
+  vector<bool> reached(graph.size(), false);
+  reached[start->graph_index] = true;
+  for (auto& node: graph.graph_view) {
+    const unsigned int here = costs[node->graph_index];
+    if (here == UINT_MAX)
+      continue;
+    for (size_t ii = 0; ii < node->neighbors_out.size(); ++ ii) {
+      const int index = node->neighbors_out[ii]->graph_index;
+      if (costs[index] > here + node->costs_out[ii])
+        return false;
+      if (costs[index] == here + node->costs_out[ii])
+        reached[index] = true;
+    }
+  }
+  for (size_t ii = 0; ii < costs.size(); ++ ii)
+    if (costs[ii] != UINT_MAX && !reached[ii])
+      return false;
+  return true;
+}
+
+void Workload::generate(Graph & graph, string map_filename, uint64_t seed,
+                        unsigned int num_buckets, unsigned int per_bucket) {
+  assert(graph.size() > 1 && num_buckets > 0);
+  Rng rng(seed);
+  this->map_filename = map_filename;
+  this->seed = seed;
+  this->num_buckets = num_buckets;
+  queries.clear();
+
+  // Estimate the largest optimal cost on the map with a double sweep: search
+  // from a random node, then again from the farthest node it reached
+  vector<unsigned int> costs;
+  Node * node = graph.graph_view[rng.below(graph.size())];
+  for (int sweep = 0; sweep < 2; ++ sweep) {
+    optimal_costs(graph, node, costs);
+    for (size_t ii = 0; ii < costs.size(); ++ ii)
+      if (costs[ii] != UINT_MAX && costs[ii] > costs[node->graph_index])
+        node = graph.graph_view[ii];
+  }
+  bucket_width = costs[node->graph_index] / num_buckets + 1;
+
+  // Take at most one goal per bucket from each random start, so that every
+  // bucket sees many starts
+  vector<vector<Query> > buckets(num_buckets);
+  vector<int> candidates;
+  const size_t max_starts = 20 * per_bucket;
+  for (size_t starts = 0; starts < max_starts; ++ starts) {
+    bool full = true;
+    for (auto& bucket: buckets)
+      full = full && bucket.size() >= per_bucket;
+    if (full)
+      break;
+    Node * start = graph.graph_view[rng.below(graph.size())];
+    optimal_costs(graph, start, costs);
+    assert(validate_costs(graph, start, costs));
+    for (unsigned int bb = 0; bb < num_buckets; ++ bb) {
+      if (buckets[bb].size() >= per_bucket)
+        continue;
+      candidates.clear();
+      for (size_t ii = 0; ii < costs.size(); ++ ii)
+        if (costs[ii] && costs[ii] != UINT_MAX && costs[ii] / bucket_width == bb)
+          candidates.push_back(ii);
+      if (candidates.empty())
+        continue;
+      Node * goal = graph.graph_view[candidates[rng.below(candidates.size())]];
+      Query query = {start->grid_x, start->grid_y, goal->grid_x, goal->grid_y,
+                     bb, costs[goal->graph_index]};
+      buckets[bb].push_back(query);
+    }
+  }
+  for (auto& bucket: buckets)
+    queries.insert(queries.end(), bucket.begin(), bucket.end());
+}
+
+bool Workload::load(string filename) {
+  ifstream file(filename.c_str(), ios::in);
+  string token;
+  int version = 0;
+  size_t num_queries = 0;
+  file >> token >> version;
+  if (!file.good() || token != "workload" || version != WORKLOAD_VERSION)
+    return false;
+  file >> token >> map_filename >> token >> seed >> token >> num_buckets >> bucket_width
+       >> token >> num_queries;
+  queries.resize(num_queries);
+  for (auto& query: queries)
+    file >> query.bucket >> query.start_x >> query.start_y >> query.goal_x >> query.goal_y
+         >> query.cost;
+  if (file.fail()) {
+    queries.clear();
+    return false;
+  }
+  return true;
+}
+
+void Workload::save(string filename) {
+  ofstream file(filename.c_str(), ios::out | ios::trunc);
+  file << "workload " << WORKLOAD_VERSION << endl
+       << "map " << map_filename << endl
+       << "seed " << seed << endl
+       << "buckets " << num_buckets << " " << bucket_width << endl
+       << "queries " << queries.size() << endl;
+  for (auto& query: queries)
+    file << query.bucket << " " << query.start_x << " " << query.start_y << " "
+         << query.goal_x << " " << query.goal_y << " " << query.cost << endl;
+  assert(file.good());
+}
+
+void write_random_map(string filename, int dim, uint64_t seed) {
+  Rng rng(seed);
+  ofstream file(filename.c_str(), ios::out | ios::trunc);
+  file << "type octile" << endl << "height " << dim << endl << "width " << dim << endl
+       << "map" << endl;
+  for (int yy = 0; yy < dim; ++ yy) {
+    for (int xx = 0; xx < dim; ++ xx) {
+      const bool corner = (xx == 0 || xx == dim - 1) && (yy == 0 || yy == dim - 1);
+      file << (!corner && rng.below(4) == 0 ? '@' : '.');
+    }
+    file << endl;
+  }
+  assert(file.good());
+}
@@ -0,0 +1,74 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "graph.h"
+
+/// SplitMix64: a small PRNG that gives the same sequence everywhere, unlike
+/// rand(), whose sequence depends on the C library.
+class Rng {
+ public:
+  Rng(uint64_t seed) { state = seed; }
+
+  inline uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  /// Uniform in [0, n), without modulo bias.
+  inline uint32_t below(uint32_t n) {
+    const uint64_t limit = UINT64_MAX - UINT64_MAX % n;
+    uint64_t x;
+    do
+      x = next();
+    while (x >= limit);
+    return x % n;
+  }
+
+  uint64_t state;
+};
+
+/// One start/goal pair and the cost of an optimal path between them.
+struct Query {
+  int start_x, start_y, goal_x, goal_y;
+  unsigned int bucket;
+  unsigned int cost;
+};
+
+/// A set of queries on one map, stratified by optimal path cost.
+// Bucket b holds queries whose optimal cost lies in [b * bucket_width,
+// (b + 1) * bucket_width), so long queries are as well represented as short
+// ones.  Workloads are saved as text: a header, then one query per line.
+class Workload {
+ public:
+  /// Draw up to `per_bucket' queries into each of `num_buckets' buckets,
+  /// spread evenly over the range of optimal costs on the map.
+  void generate(Graph & graph, string map_filename, uint64_t seed,
+                unsigned int num_buckets, unsigned int per_bucket);
+  bool load(string filename);
+  void save(string filename);
+
+  string map_filename;
+  vector<Query> queries;              // in bucket order
+  uint64_t seed;
+  unsigned int num_buckets, bucket_width;
+};
+
+/// The optimal cost from `start' to every node (indexed by graph_index), by
+/// Dijkstra's algorithm; UINT_MAX where there's no path.
+void optimal_costs(Graph & graph, Node * start, vector<unsigned int> & costs);
+
+/// Check that `costs' are the optimal costs from `start': no edge offers a
+/// shortcut, and every other reachable node is reached by some edge exactly.
+bool validate_costs(Graph & graph, Node * start, vector<unsigned int> & costs);
+
+/// Write out a random ascii map with about a quarter of its cells blocked,
+/// keeping the corners open.  The same seed gives the same map everywhere.
+void write_random_map(string filename, int dim, uint64_t seed);
+
+#endif // WORKLOAD_H